@@ -0,0 +1,137 @@
+#include <string.h>
+
+#include "flash_store.h"
+
+static uint8_t slot_buffer[FLASH_STORE_SECTOR_SIZE];
+
+static uint32_t _flash_store_crc32(const uint8_t *data, size_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static int _flash_store_slots_per_sector(const struct FlashStore *store) {
+    return FLASH_STORE_SECTOR_SIZE / store->slot_size;
+}
+
+// Slots are numbered through the first sector and then the second
+static uint32_t _flash_store_slot_offset(const struct FlashStore *store, int slot) {
+    return store->offset + (uint32_t)slot * store->slot_size;
+}
+
+/*
+* Find the slot containing the most recently saved valid record.
+* Slots that are unused or failed to write correctly are skipped over.
+*/
+static int _flash_store_find_newest(const struct FlashStore *store,
+        struct FlashStoreSlotHeader *newest_header) {
+    int newest_slot = -1;
+
+    for (int slot = 0; slot < FLASH_STORE_SECTOR_COUNT * _flash_store_slots_per_sector(store); slot++) {
+        struct FlashStoreSlotHeader header;
+        flash_store_device_read(_flash_store_slot_offset(store, slot), &header, sizeof(header));
+
+        if (header.magic != FLASH_STORE_MAGIC
+                || header.length > store->slot_size - sizeof(header)) {
+            continue;
+        }
+
+        flash_store_device_read(
+            _flash_store_slot_offset(store, slot) + sizeof(header), slot_buffer, header.length);
+        if (_flash_store_crc32(slot_buffer, header.length) != header.crc) {
+            continue;
+        }
+
+        if (newest_slot == -1 || header.sequence > newest_header->sequence) {
+            newest_slot = slot;
+            *newest_header = header;
+        }
+    }
+
+    return newest_slot;
+}
+
+/*
+* Find the first slot from first up to (but not including) end that has never been written to.
+* Returns -1 if they have all been used.
+*/
+static int _flash_store_find_unused(const struct FlashStore *store, int first, int end) {
+    for (int slot = first; slot < end; slot++) {
+        uint32_t magic;
+        flash_store_device_read(_flash_store_slot_offset(store, slot), &magic, sizeof(magic));
+        if (magic == 0xFFFFFFFF) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+bool flash_store_load(const struct FlashStore *store, void *data, size_t length) {
+    struct FlashStoreSlotHeader header;
+    int slot = _flash_store_find_newest(store, &header);
+    if (slot == -1 || header.length != length) {
+        return false;
+    }
+
+    flash_store_device_read(_flash_store_slot_offset(store, slot) + sizeof(header), data, length);
+    return true;
+}
+
+bool flash_store_save(const struct FlashStore *store, const void *data, size_t length) {
+    if (length > store->slot_size - sizeof(struct FlashStoreSlotHeader)) {
+        return false;
+    }
+
+    struct FlashStoreSlotHeader newest_header = {0};
+    int newest_slot = _flash_store_find_newest(store, &newest_header);
+
+    // Slots in a sector are used in order, so carry on after the most recent record
+    int slots_per_sector = _flash_store_slots_per_sector(store);
+    int sector = newest_slot == -1 ? 0 : newest_slot / slots_per_sector;
+    int next_free_slot = _flash_store_find_unused(store,
+        newest_slot == -1 ? 0 : newest_slot + 1, (sector + 1) * slots_per_sector);
+
+    if (next_free_slot == -1) {
+        // Every slot in this sector has been used - erase the other sector and start filling it.
+        // The other sector only holds older records, so the most recent one survives if power is lost.
+        if (newest_slot != -1) {
+            sector = (sector + 1) % FLASH_STORE_SECTOR_COUNT;
+        }
+        flash_store_device_erase(store->offset + (uint32_t)sector * FLASH_STORE_SECTOR_SIZE);
+        next_free_slot = sector * slots_per_sector;
+    }
+
+    struct FlashStoreSlotHeader header = {
+        .magic = FLASH_STORE_MAGIC,
+        .sequence = newest_slot == -1 ? 0 : newest_header.sequence + 1,
+        .length = length,
+        .crc = _flash_store_crc32(data, length)
+    };
+
+    // Unused bytes are left erased so they can be programmed later if needed
+    memset(slot_buffer, 0xFF, store->slot_size);
+    memcpy(slot_buffer, &header, sizeof(header));
+    memcpy(slot_buffer + sizeof(header), data, length);
+
+    uint32_t offset = _flash_store_slot_offset(store, next_free_slot);
+    // Only program the pages that contain data
+    size_t program_length = (sizeof(header) + length + FLASH_STORE_PAGE_SIZE - 1)
+        / FLASH_STORE_PAGE_SIZE * FLASH_STORE_PAGE_SIZE;
+    flash_store_device_program(offset, slot_buffer, program_length);
+
+    // Check the record was written correctly
+    flash_store_device_read(offset, slot_buffer, sizeof(header) + length);
+    return memcmp(slot_buffer, &header, sizeof(header)) == 0
+        && memcmp(slot_buffer + sizeof(header), data, length) == 0;
+}
+
+void flash_store_erase(const struct FlashStore *store) {
+    for (int sector = 0; sector < FLASH_STORE_SECTOR_COUNT; sector++) {
+        flash_store_device_erase(store->offset + (uint32_t)sector * FLASH_STORE_SECTOR_SIZE);
+    }
+}
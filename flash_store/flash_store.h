@@ -0,0 +1,82 @@
+#ifndef FLASH_STORE_H
+#define FLASH_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Smallest area of flash that can be erased at once
+#define FLASH_STORE_SECTOR_SIZE 4096
+// Smallest area of flash that can be programmed at once
+#define FLASH_STORE_PAGE_SIZE 256
+
+// Sectors used by each store, so one can be erased while the other still holds the latest record
+#define FLASH_STORE_SECTOR_COUNT 2
+#define FLASH_STORE_SIZE (FLASH_STORE_SECTOR_COUNT * FLASH_STORE_SECTOR_SIZE)
+
+#define FLASH_STORE_MAGIC 0x544C4653
+
+/*
+* A pair of flash sectors used to store a single record.
+* Each sector is split into equally sized slots, and each save is written to the
+* next unused slot. Once every slot in a sector has been used, the other sector
+* is erased and filled next, so the most recent record is never erased before
+* a newer one has been written.
+* slot_size must be a multiple of FLASH_STORE_PAGE_SIZE that divides FLASH_STORE_SECTOR_SIZE,
+* and must leave room for the slot header.
+*/
+struct FlashStore {
+    // Offset of the first sector from the start of flash, must be a multiple of FLASH_STORE_SECTOR_SIZE
+    uint32_t offset;
+    uint16_t slot_size;
+};
+
+struct FlashStoreSlotHeader {
+    uint32_t magic;
+    // Incremented with each save so the most recent slot can be found
+    uint32_t sequence;
+    uint32_t length;
+    // CRC-32 of the record data
+    uint32_t crc;
+};
+
+// DEVICE METHODS
+// Implemented by one of flash_store_pico.c (on-board flash) or flash_store_file.c (host file).
+
+/*
+* Read bytes from flash. Erased flash reads as 0xFF.
+*/
+void flash_store_device_read(uint32_t offset, void *data, size_t length);
+
+/*
+* Erase the sector starting at offset, setting every byte to 0xFF.
+*/
+void flash_store_device_erase(uint32_t offset);
+
+/*
+* Program whole pages of flash. Programming can only clear bits,
+* so the pages should have been erased beforehand.
+*/
+void flash_store_device_program(uint32_t offset, const void *data, size_t length);
+
+// STORE METHODS
+
+/*
+* Read the most recently saved record into data.
+* Returns false if there is no valid record with the given length.
+*/
+bool flash_store_load(const struct FlashStore *store, void *data, size_t length);
+
+/*
+* Save a record, replacing any previously saved record.
+* length must be no greater than store->slot_size - sizeof(struct FlashStoreSlotHeader).
+* Returns false if the record is too large or did not read back correctly.
+*/
+bool flash_store_save(const struct FlashStore *store, const void *data, size_t length);
+
+/*
+* Erase every saved record.
+*/
+void flash_store_erase(const struct FlashStore *store);
+
+#endif
@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "flash_store.h"
+#include "flash_store_file.h"
+
+static const char *file_path = "flash_store.bin";
+
+void flash_store_file_set_path(const char *path) {
+    file_path = path;
+}
+
+static FILE *_flash_store_file_open(void) {
+    FILE *file = fopen(file_path, "r+b");
+    if (file == NULL) {
+        file = fopen(file_path, "w+b");
+    }
+    return file;
+}
+
+/*
+* Read from the file, treating anything past the end of it as erased flash.
+*/
+static void _flash_store_file_read(FILE *file, uint32_t offset, uint8_t *data, size_t length) {
+    memset(data, 0xFF, length);
+    if (fseek(file, offset, SEEK_SET) == 0) {
+        fread(data, 1, length, file);
+    }
+}
+
+static void _flash_store_file_write(FILE *file, uint32_t offset, const uint8_t *data, size_t length) {
+    // Pad any gap between the end of the file and offset with erased bytes
+    fseek(file, 0, SEEK_END);
+    for (long end = ftell(file); end < (long)offset; end++) {
+        fputc(0xFF, file);
+    }
+    fseek(file, offset, SEEK_SET);
+    fwrite(data, 1, length, file);
+}
+
+void flash_store_device_read(uint32_t offset, void *data, size_t length) {
+    FILE *file = fopen(file_path, "rb");
+    if (file == NULL) {
+        memset(data, 0xFF, length);
+        return;
+    }
+    _flash_store_file_read(file, offset, data, length);
+    fclose(file);
+}
+
+void flash_store_device_erase(uint32_t offset) {
+    FILE *file = _flash_store_file_open();
+    if (file == NULL) {
+        return;
+    }
+    uint8_t erased[FLASH_STORE_SECTOR_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+    _flash_store_file_write(file, offset, erased, sizeof(erased));
+    fclose(file);
+}
+
+void flash_store_device_program(uint32_t offset, const void *data, size_t length) {
+    FILE *file = _flash_store_file_open();
+    if (file == NULL) {
+        return;
+    }
+    uint8_t page[FLASH_STORE_PAGE_SIZE];
+    const uint8_t *bytes = data;
+    for (size_t start = 0; start < length; start += FLASH_STORE_PAGE_SIZE) {
+        size_t page_length = length - start < FLASH_STORE_PAGE_SIZE
+            ? length - start : FLASH_STORE_PAGE_SIZE;
+        _flash_store_file_read(file, offset + start, page, page_length);
+        // Like real flash, programming can only change bits from 1 to 0
+        for (size_t i = 0; i < page_length; i++) {
+            page[i] &= bytes[start + i];
+        }
+        _flash_store_file_write(file, offset + start, page, page_length);
+    }
+    fclose(file);
+}
@@ -0,0 +1,10 @@
+#ifndef FLASH_STORE_FILE_H
+#define FLASH_STORE_FILE_H
+
+/*
+* Set the file used in place of flash memory when running on a host computer.
+* The file is created when it is first written to. Defaults to "flash_store.bin".
+*/
+void flash_store_file_set_path(const char *path);
+
+#endif
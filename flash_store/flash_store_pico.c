@@ -0,0 +1,24 @@
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+#include "flash_store.h"
+
+void flash_store_device_read(uint32_t offset, void *data, size_t length) {
+    // Flash is memory mapped, so can be read directly
+    memcpy(data, (const void *)(XIP_BASE + offset), length);
+}
+
+void flash_store_device_erase(uint32_t offset) {
+    // Code running from flash can't be allowed to run while flash is being written
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_erase(offset, FLASH_SECTOR_SIZE);
+    restore_interrupts(interrupts);
+}
+
+void flash_store_device_program(uint32_t offset, const void *data, size_t length) {
+    uint32_t interrupts = save_and_disable_interrupts();
+    flash_range_program(offset, data, length);
+    restore_interrupts(interrupts);
+}
@@ -0,0 +1,165 @@
+#include <string.h>
+
+#include "hd44780_emulator.h"
+
+#define SECOND_LINE_DDRAM 0x40
+#define TWO_LINE_LENGTH 40
+#define ONE_LINE_LENGTH 80
+
+static uint8_t _hd44780_line_length(const struct HD44780Emulator *display) {
+    return display->function_set & 0b1000 ? TWO_LINE_LENGTH : ONE_LINE_LENGTH;
+}
+
+static uint8_t _hd44780_next_address(const struct HD44780Emulator *display, bool increment) {
+    if (display->cgram_selected) {
+        return (display->address + (increment ? 1 : -1)) & (HD44780_CGRAM_SIZE - 1);
+    }
+
+    // Work with the position within a line, then put the line start back on
+    uint8_t line_length = _hd44780_line_length(display);
+    uint8_t line_start = display->address >= SECOND_LINE_DDRAM && line_length == TWO_LINE_LENGTH
+        ? SECOND_LINE_DDRAM : 0;
+    int offset = display->address - line_start + (increment ? 1 : -1);
+    if (offset >= line_length || offset < 0) {
+        if (line_length == TWO_LINE_LENGTH) {
+            // The end of each line runs onto the start of the other
+            line_start = line_start == 0 ? SECOND_LINE_DDRAM : 0;
+        }
+        offset = offset < 0 ? line_length - 1 : 0;
+    }
+    return line_start + offset;
+}
+
+static void _hd44780_shift_display(struct HD44780Emulator *display, bool right) {
+    uint8_t line_length = _hd44780_line_length(display);
+    display->display_shift = (display->display_shift + (right ? 1 : line_length - 1)) % line_length;
+}
+
+static void _hd44780_execute_instruction(struct HD44780Emulator *display, uint8_t data) {
+    display->instructions++;
+
+    if (data & 0b10000000) {
+        display->cgram_selected = false;
+        display->address = data & 0b1111111;
+    } else if (data & 0b1000000) {
+        display->cgram_selected = true;
+        display->address = data & 0b111111;
+    } else if (data & 0b100000) {
+        display->function_set = data;
+        display->four_bit = !(data & 0b10000);
+        display->lower_nibble_next = false;
+    } else if (data & 0b10000) {
+        if (data & 0b1000) {
+            _hd44780_shift_display(display, data & 0b100);
+        } else {
+            display->address = _hd44780_next_address(display, data & 0b100);
+        }
+    } else if (data & 0b1000) {
+        display->display_control = data;
+    } else if (data & 0b100) {
+        display->entry_mode = data;
+    } else if (data & 0b10) {
+        display->cgram_selected = false;
+        display->address = 0;
+        display->display_shift = 0;
+    } else if (data & 1) {
+        memset(display->ddram, ' ', HD44780_DDRAM_SIZE);
+        display->cgram_selected = false;
+        display->address = 0;
+        display->display_shift = 0;
+        display->entry_mode |= 0b10;
+    }
+}
+
+static void _hd44780_write_data(struct HD44780Emulator *display, uint8_t data) {
+    display->data_writes++;
+
+    if (display->cgram_selected) {
+        display->cgram[display->address] = data;
+    } else {
+        display->ddram[display->address] = data;
+        if (display->entry_mode & 1) {
+            _hd44780_shift_display(display, !(display->entry_mode & 0b10));
+        }
+    }
+    display->address = _hd44780_next_address(display, display->entry_mode & 0b10);
+}
+
+static uint8_t _hd44780_read(struct HD44780Emulator *display, bool rs_value) {
+    if (!rs_value) {
+        // Busy flag is always clear
+        return display->address;
+    }
+
+    display->data_reads++;
+    uint8_t data = display->cgram_selected
+        ? display->cgram[display->address] : display->ddram[display->address];
+    display->address = _hd44780_next_address(display, display->entry_mode & 0b10);
+    return data;
+}
+
+void hd44780_emulator_init(struct HD44780Emulator *display) {
+    memset(display, 0, sizeof(*display));
+    display->function_set = 0b110000;
+    display->display_control = 0b1000;
+    display->entry_mode = 0b110;
+    // DDRAM contents are undefined on power up, fill with something visible
+    memset(display->ddram, '?', HD44780_DDRAM_SIZE);
+}
+
+uint8_t hd44780_emulator_cycle_enable(
+        struct HD44780Emulator *display, bool rs_value, bool rw_value, uint8_t data_pins) {
+    display->enable_cycles++;
+
+    if (display->four_bit) {
+        if (!display->lower_nibble_next) {
+            display->lower_nibble_next = true;
+            if (rw_value) {
+                // Read the whole byte now, the lower nibble is given out on the next cycle
+                display->upper_nibble = _hd44780_read(display, rs_value);
+                return display->upper_nibble & 0b11110000;
+            }
+            display->upper_nibble = data_pins & 0b11110000;
+            return 0;
+        }
+
+        display->lower_nibble_next = false;
+        if (rw_value) {
+            return display->upper_nibble << 4;
+        }
+        data_pins = display->upper_nibble | (data_pins >> 4);
+    } else if (rw_value) {
+        return _hd44780_read(display, rs_value);
+    }
+
+    if (rs_value) {
+        _hd44780_write_data(display, data_pins);
+    } else {
+        _hd44780_execute_instruction(display, data_pins);
+    }
+    return 0;
+}
+
+void hd44780_emulator_read(
+        const struct HD44780Emulator *display, uint8_t width, uint8_t height, char *string) {
+    uint8_t line_length = _hd44780_line_length(display);
+    int characters_per_line = width + 1;
+
+    for (int y = 0; y < height; y++) {
+        // Lines 3 and 4 are continuations of lines 1 and 2
+        uint8_t line_start = y % 2 != 0 ? SECOND_LINE_DDRAM : 0;
+        uint8_t line_offset = y >= 2 ? width : 0;
+        for (int x = 0; x < width; x++) {
+            // Shifting the display right moves earlier characters into view
+            int offset = (line_offset + x - display->display_shift + line_length) % line_length;
+            uint8_t data = display->ddram[line_start + offset];
+            if (data <= 7) {
+                // Convert 0-indexed custom character to 1-indexed
+                ++data;
+            }
+            string[y * characters_per_line + x] = data;
+        }
+        string[y * characters_per_line + width] = '\n';
+    }
+    string[height * characters_per_line - 1] = '\0';
+}
@@ -0,0 +1,56 @@
+#ifndef HD44780_EMULATOR_H
+#define HD44780_EMULATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Host-side model of a HD44780 display controller, for running the
+// controller methods without a physical display. Instructions execute
+// instantly, so the busy flag is never set.
+
+#define HD44780_DDRAM_SIZE 128
+#define HD44780_CGRAM_SIZE 64
+
+struct HD44780Emulator {
+    bool four_bit;
+    // In 4-bit mode, whether the next enable cycle transfers the lower nibble
+    bool lower_nibble_next;
+    uint8_t upper_nibble;
+
+    uint8_t function_set;
+    uint8_t display_control;
+    uint8_t entry_mode;
+    bool cgram_selected;
+    uint8_t address;
+    uint8_t display_shift;
+    uint8_t ddram[HD44780_DDRAM_SIZE];
+    uint8_t cgram[HD44780_CGRAM_SIZE];
+
+    // Counters for measuring how much work the display was given
+    uint32_t enable_cycles;
+    uint32_t instructions;
+    uint32_t data_writes;
+    uint32_t data_reads;
+};
+
+/*
+* Put the emulated display into its power on state: 8-bit interface, 1 line, display off.
+*/
+void hd44780_emulator_init(struct HD44780Emulator *display);
+
+/*
+* Cycle the enable line of the emulated display.
+* data_pins holds D7-D0, only D7-D4 are used in 4-bit mode.
+* Returns the value the display puts on D7-D0 when rw_value is true.
+*/
+uint8_t hd44780_emulator_cycle_enable(
+    struct HD44780Emulator *display, bool rs_value, bool rw_value, uint8_t data_pins);
+
+/*
+* Get the text currently visible on the emulated display, in the same format as lcd_read.
+* String must have enough capacity for (width + 1) * height.
+*/
+void hd44780_emulator_read(
+    const struct HD44780Emulator *display, uint8_t width, uint8_t height, char *string);
+
+#endif
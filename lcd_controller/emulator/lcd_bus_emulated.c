@@ -0,0 +1,54 @@
+#include <stddef.h>
+
+#include "hd44780_emulator.h"
+#include "lcd_bus.h"
+#include "lcd_bus_emulated.h"
+
+static struct HD44780Emulator *emulated_display;
+
+static void _lcd_emulated_write(bool rs_value, uint8_t data);
+static void _lcd_emulated_write_nibble(bool rs_value, uint8_t nibble);
+static uint8_t _lcd_emulated_read(bool rs_value);
+static void _lcd_emulated_delay(uint32_t us);
+
+static struct LCDBus emulated_bus = {
+    .interface = LCD_INTERFACE_8BIT,
+    .write = _lcd_emulated_write,
+    .write_nibble = _lcd_emulated_write_nibble,
+    .read = _lcd_emulated_read,
+    .delay = _lcd_emulated_delay,
+    .flush = NULL,
+    .set_backlight = NULL
+};
+
+static void _lcd_emulated_write(bool rs_value, uint8_t data) {
+    if (emulated_bus.interface == LCD_INTERFACE_4BIT) {
+        hd44780_emulator_cycle_enable(emulated_display, rs_value, false, data & 0b11110000);
+        hd44780_emulator_cycle_enable(emulated_display, rs_value, false, data << 4);
+    } else {
+        hd44780_emulator_cycle_enable(emulated_display, rs_value, false, data);
+    }
+}
+
+static void _lcd_emulated_write_nibble(bool rs_value, uint8_t nibble) {
+    hd44780_emulator_cycle_enable(emulated_display, rs_value, false, nibble << 4);
+}
+
+static uint8_t _lcd_emulated_read(bool rs_value) {
+    uint8_t data = hd44780_emulator_cycle_enable(emulated_display, rs_value, true, 0);
+    if (emulated_bus.interface == LCD_INTERFACE_4BIT) {
+        data = (data & 0b11110000)
+            | (hd44780_emulator_cycle_enable(emulated_display, rs_value, true, 0) >> 4);
+    }
+    return data;
+}
+
+static void _lcd_emulated_delay(uint32_t us) {
+    // Emulated display executes everything instantly
+}
+
+void lcd_init_emulated(struct HD44780Emulator *display, enum LCDInterface interface) {
+    emulated_display = display;
+    emulated_bus.interface = interface;
+    _lcd_set_bus(&emulated_bus);
+}
@@ -0,0 +1,13 @@
+#ifndef LCD_BUS_EMULATED_H
+#define LCD_BUS_EMULATED_H
+
+#include "hd44780_emulator.h"
+#include "lcd_controller.h"
+
+/*
+* Use an emulated display for all controller methods, for running them on a host computer.
+* The emulated display is connected as if it were wired directly to the GPIO pins.
+*/
+void lcd_init_emulated(struct HD44780Emulator *display, enum LCDInterface interface);
+
+#endif
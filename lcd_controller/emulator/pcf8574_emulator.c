@@ -0,0 +1,28 @@
+#include "pcf8574_emulator.h"
+
+#define PCF8574_RS_BIT 0b1
+#define PCF8574_RW_BIT 0b10
+#define PCF8574_E_BIT 0b100
+
+void pcf8574_emulator_init(struct PCF8574Emulator *expander, struct HD44780Emulator *display) {
+    expander->display = display;
+    expander->output = 0xFF;
+    expander->transactions = 0;
+    expander->bytes = 0;
+}
+
+void pcf8574_emulator_write(struct PCF8574Emulator *expander, const uint8_t *data, size_t length) {
+    expander->transactions++;
+    expander->bytes += length;
+
+    for (size_t i = 0; i < length; i++) {
+        uint8_t previous = expander->output;
+        expander->output = data[i];
+        // The display acts when enable goes low
+        if ((previous & PCF8574_E_BIT) && !(expander->output & PCF8574_E_BIT)) {
+            hd44780_emulator_cycle_enable(expander->display,
+                expander->output & PCF8574_RS_BIT, expander->output & PCF8574_RW_BIT,
+                expander->output & 0b11110000);
+        }
+    }
+}
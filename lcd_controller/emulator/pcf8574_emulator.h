@@ -0,0 +1,31 @@
+#ifndef PCF8574_EMULATOR_H
+#define PCF8574_EMULATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hd44780_emulator.h"
+
+// Host-side model of a PCF8574 I2C backpack connected to a HD44780 display,
+// wired the same way as the lcd_bus_pcf8574 backend expects.
+
+struct PCF8574Emulator {
+    struct HD44780Emulator *display;
+    uint8_t output;
+
+    // Counters for measuring how efficiently the bus is used
+    uint32_t transactions;
+    uint32_t bytes;
+};
+
+/*
+* Put the emulated expander into its power on state, with every output high.
+*/
+void pcf8574_emulator_init(struct PCF8574Emulator *expander, struct HD44780Emulator *display);
+
+/*
+* Receive a single I2C write transaction, setting the outputs to each byte in turn.
+*/
+void pcf8574_emulator_write(struct PCF8574Emulator *expander, const uint8_t *data, size_t length);
+
+#endif
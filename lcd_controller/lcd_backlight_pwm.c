@@ -0,0 +1,169 @@
+#include <math.h>
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/pwm.h"
+
+#include "lcd_bus.h"
+#include "lcd_controller.h"
+
+// 16-bit duty cycle, giving ~1.9kHz PWM at 125MHz.
+// The resolution is needed for the dimmest levels once gamma correction is applied.
+#define BACKLIGHT_PWM_WRAP 65535
+#define BACKLIGHT_GAMMA 2.2f
+
+// Each step of a fade is held for a whole number of pacing slice periods of 1us each,
+// up to the slice's 16-bit counter limit
+#define BACKLIGHT_PACING_TICK_HZ 1000000
+#define BACKLIGHT_MAX_STEP_US 65535
+// Steps are at least 1ms long, so there are as many steps as milliseconds up to this limit
+#define BACKLIGHT_MAX_STEPS 512
+
+// Compare values for each perceived brightness level
+static uint16_t gamma_table[LCD_BACKLIGHT_MAX_LEVEL + 1];
+// Compare register values for each step of the current fade or breathing cycle
+static uint32_t steps[BACKLIGHT_MAX_STEPS];
+// Read by the control channel to restart the data channel while breathing
+static const uint32_t *steps_start = steps;
+
+static uint slice;
+static uint channel;
+static int data_channel;
+static int control_channel;
+
+static uint32_t _backlight_compare_value(uint8_t level) {
+    // Writing the whole register sets the other channel of the slice to 0,
+    // which is fine as only LCD_A_PIN is used for PWM
+    return channel == PWM_CHAN_A ? gamma_table[level] : (uint32_t)gamma_table[level] << 16;
+}
+
+static void _backlight_stop(void) {
+    // Stop the control channel first so it can't restart the data channel
+    dma_channel_abort(control_channel);
+    dma_channel_abort(data_channel);
+    dma_channel_abort(control_channel);
+}
+
+/*
+* Set the pacing slice so each step of a fade lasts step_us.
+*/
+static void _backlight_set_step_time(uint32_t step_us) {
+    pwm_set_wrap(LCD_BACKLIGHT_PACING_PWM_SLICE, (uint16_t)(step_us - 1));
+    pwm_set_counter(LCD_BACKLIGHT_PACING_PWM_SLICE, 0);
+}
+
+/*
+* Fill steps with a fade between two levels, not including the starting level.
+* Returns the number of steps written.
+*/
+static uint32_t _backlight_fill_fade(uint32_t *buffer, uint8_t from, uint8_t to, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        // Levels are already perceptual, so step through them evenly
+        int level = from + ((int)to - from) * (int)(i + 1) / (int)count;
+        buffer[i] = _backlight_compare_value((uint8_t)level);
+    }
+    return count;
+}
+
+static void _backlight_start(uint32_t count, bool repeat) {
+    dma_channel_config data_config = dma_channel_get_default_config(data_channel);
+    channel_config_set_transfer_data_size(&data_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&data_config, true);
+    channel_config_set_write_increment(&data_config, false);
+    channel_config_set_dreq(&data_config, pwm_get_dreq(LCD_BACKLIGHT_PACING_PWM_SLICE));
+    // Chaining to itself means not chaining
+    channel_config_set_chain_to(&data_config, repeat ? control_channel : data_channel);
+    dma_channel_configure(data_channel, &data_config, &pwm_hw->slice[slice].cc, steps, count, true);
+}
+
+uint8_t _lcd_pwm_backlight_get_level(void) {
+    uint16_t compare = channel == PWM_CHAN_A
+        ? pwm_hw->slice[slice].cc & 0xFFFF
+        : pwm_hw->slice[slice].cc >> 16;
+    // Find the dimmest level with this duty cycle
+    // (the dimmest few levels all round down to 0)
+    int low = 0;
+    int high = LCD_BACKLIGHT_MAX_LEVEL;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (gamma_table[middle] >= compare) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+    return (uint8_t)low;
+}
+
+void _lcd_pwm_backlight_fade(uint8_t level, uint32_t fade_ms) {
+    _backlight_stop();
+    uint8_t current = _lcd_pwm_backlight_get_level();
+
+    if (fade_ms == 0 || current == level) {
+        pwm_set_chan_level(slice, channel, gamma_table[level]);
+        return;
+    }
+
+    uint32_t count = fade_ms < BACKLIGHT_MAX_STEPS ? fade_ms : BACKLIGHT_MAX_STEPS;
+    uint32_t step_us = (fade_ms * 1000) / count;
+    if (step_us > BACKLIGHT_MAX_STEP_US) {
+        step_us = BACKLIGHT_MAX_STEP_US;
+    }
+    _backlight_fill_fade(steps, current, level, count);
+    _backlight_set_step_time(step_us);
+    _backlight_start(count, false);
+}
+
+void _lcd_pwm_backlight_breathe(uint8_t level, uint32_t period_ms) {
+    _backlight_stop();
+
+    // Half the steps fade in and half fade out
+    uint32_t count = period_ms < BACKLIGHT_MAX_STEPS ? period_ms : BACKLIGHT_MAX_STEPS;
+    count &= ~1u;
+    if (count < 2) {
+        count = 2;
+    }
+    uint32_t step_us = (period_ms * 1000) / count;
+    if (step_us > BACKLIGHT_MAX_STEP_US) {
+        step_us = BACKLIGHT_MAX_STEP_US;
+    }
+    _backlight_fill_fade(steps, 0, level, count / 2);
+    _backlight_fill_fade(&steps[count / 2], level, 0, count / 2);
+
+    // The control channel puts the data channel back to the start of the steps each time it finishes
+    dma_channel_config control_config = dma_channel_get_default_config(control_channel);
+    channel_config_set_transfer_data_size(&control_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&control_config, false);
+    channel_config_set_write_increment(&control_config, false);
+    dma_channel_configure(control_channel, &control_config,
+        &dma_hw->ch[data_channel].al3_read_addr_trig, &steps_start, 1, false);
+
+    _backlight_set_step_time(step_us);
+    _backlight_start(count, true);
+}
+
+void _lcd_pwm_backlight_init(void) {
+    for (int i = 0; i <= LCD_BACKLIGHT_MAX_LEVEL; i++) {
+        gamma_table[i] = (uint16_t)lroundf(
+            powf((float)i / LCD_BACKLIGHT_MAX_LEVEL, BACKLIGHT_GAMMA) * BACKLIGHT_PWM_WRAP);
+    }
+
+    slice = pwm_gpio_to_slice_num(LCD_A_PIN);
+    channel = pwm_gpio_to_channel(LCD_A_PIN);
+    gpio_set_function(LCD_A_PIN, GPIO_FUNC_PWM);
+    pwm_config backlight_config = pwm_get_default_config();
+    pwm_config_set_wrap(&backlight_config, BACKLIGHT_PWM_WRAP);
+    // Start off, as the backlight was before PWM was used
+    pwm_init(slice, &backlight_config, false);
+    pwm_set_chan_level(slice, channel, 0);
+    pwm_set_enabled(slice, true);
+
+    // The pacing slice's output isn't connected to any pin, only its wrap is used to pace DMA
+    pwm_config pacing_config = pwm_get_default_config();
+    pwm_config_set_clkdiv(&pacing_config, (float)clock_get_hz(clk_sys) / BACKLIGHT_PACING_TICK_HZ);
+    pwm_config_set_wrap(&pacing_config, 999);
+    pwm_init(LCD_BACKLIGHT_PACING_PWM_SLICE, &pacing_config, true);
+
+    data_channel = dma_claim_unused_channel(true);
+    control_channel = dma_claim_unused_channel(true);
+}
@@ -0,0 +1,87 @@
+#ifndef LCD_BUS_H
+#define LCD_BUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lcd_controller.h"
+
+/*
+* The connection between the controller methods and a physical display.
+* Each bus handles splitting bytes into nibbles in 4-bit mode and cycling the enable line.
+*/
+struct LCDBus {
+    enum LCDInterface interface;
+
+    /*
+    * Send an 8-bit value with the RS pin either enabled or disabled.
+    * Buses that can't read must leave at least LCD_SHORT_SLEEP_US between
+    * the end of one write and the end of the next.
+    */
+    void (*write)(bool rs_value, uint8_t data);
+
+    /*
+    * Send a 4-bit value on D7-D4 with a single enable cycle.
+    */
+    void (*write_nibble)(bool rs_value, uint8_t nibble);
+
+    /*
+    * Receive an 8-bit value with the RS pin either enabled or disabled.
+    * NULL if the bus can't read from the display.
+    */
+    uint8_t (*read)(bool rs_value);
+
+    /*
+    * Leave at least the given amount of time between the previous write
+    * reaching the display and the next write.
+    */
+    void (*delay)(uint32_t us);
+
+    /*
+    * Send any queued writes to the display. NULL if the bus doesn't queue writes.
+    */
+    void (*flush)(void);
+
+    /*
+    * Turn the backlight on or off. NULL if the backlight is connected to LCD_A_PIN.
+    */
+    void (*set_backlight)(bool power);
+};
+
+/*
+* Set the bus used by all controller methods.
+*/
+void _lcd_set_bus(const struct LCDBus *new_bus);
+
+/*
+* Report that a write didn't reach the display (e.g. an I2C backpack didn't acknowledge it),
+* so lcd_check_health restores the display. For buses that can't otherwise tell the display is missing.
+*/
+void _lcd_report_bus_error(void);
+
+/*
+* Set up PWM on LCD_A_PIN and the DMA channels used for fades, with the backlight off.
+* Used by buses that leave the backlight connected to LCD_A_PIN.
+*/
+void _lcd_pwm_backlight_init(void);
+
+/*
+* Fade the backlight on LCD_A_PIN from its current brightness to a level over fade_ms,
+* or change it immediately if fade_ms is 0. Stops any fade or breathing in progress.
+* Runs entirely in the background.
+*/
+void _lcd_pwm_backlight_fade(uint8_t level, uint32_t fade_ms);
+
+/*
+* Repeatedly fade the backlight on LCD_A_PIN up from off to a level and back down again,
+* taking period_ms for each cycle, until the next fade.
+* Runs entirely in the background.
+*/
+void _lcd_pwm_backlight_breathe(uint8_t level, uint32_t period_ms);
+
+/*
+* Get the current brightness of the backlight on LCD_A_PIN, part way through any fade.
+*/
+uint8_t _lcd_pwm_backlight_get_level(void);
+
+#endif
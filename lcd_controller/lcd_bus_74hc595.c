@@ -0,0 +1,158 @@
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/spi.h"
+
+#include "lcd_bus.h"
+#include "lcd_controller.h"
+
+// Shift register wiring matches the PCF8574 backpack:
+// Q0 = RS, Q2 = E, Q3 = backlight, Q7-Q4 = D7-D4. Display RW is tied to ground.
+// SPI chip select drives the storage register clock, so every byte is latched as soon as it arrives.
+#define SHIFT_REGISTER_RS_BIT 0b1
+#define SHIFT_REGISTER_E_BIT 0b100
+#define SHIFT_REGISTER_BACKLIGHT_BIT 0b1000
+
+// Enough for a full 20x4 refresh, or a clear instruction's worth of padding, in a single transfer
+#define SHIFT_REGISTER_BUFFER_LENGTH 1024
+
+static void _shift_register_write(bool rs_value, uint8_t data);
+static void _shift_register_write_nibble(bool rs_value, uint8_t nibble);
+static void _shift_register_delay(uint32_t us);
+static void _shift_register_flush(void);
+static void _shift_register_set_backlight(bool power);
+
+static const struct LCDBus shift_register_bus = {
+    .interface = LCD_INTERFACE_4BIT,
+    .write = _shift_register_write,
+    .write_nibble = _shift_register_write_nibble,
+    .read = NULL,
+    .delay = _shift_register_delay,
+    .flush = _shift_register_flush,
+    .set_backlight = _shift_register_set_backlight
+};
+
+static spi_inst_t *const spi = LCD_SPI_INSTANCE;
+
+static int dma_channel;
+static dma_channel_config dma_config;
+
+// Bytes are queued into one buffer while the other is being sent by DMA
+static uint8_t buffers[2][SHIFT_REGISTER_BUFFER_LENGTH];
+static int active_buffer = 0;
+static size_t buffer_length = 0;
+static bool transfer_in_progress = false;
+
+// Shortest time a byte can take to send, used to turn delays into padding bytes
+static uint32_t byte_time_ns;
+
+static uint8_t backlight_bit = SHIFT_REGISTER_BACKLIGHT_BIT;
+static uint8_t last_output;
+
+static void _shift_register_wait_for_transfer(void) {
+    if (!transfer_in_progress) {
+        return;
+    }
+    dma_channel_wait_for_finish_blocking(dma_channel);
+    // DMA finishes once the last byte is in the FIFO, not once it has been sent
+    while (spi_is_busy(spi)) { }
+    transfer_in_progress = false;
+}
+
+static void _shift_register_flush(void) {
+    if (buffer_length == 0) {
+        return;
+    }
+
+    // Only one transfer can be sent at a time
+    _shift_register_wait_for_transfer();
+
+    dma_channel_configure(dma_channel, &dma_config,
+        &spi_get_hw(spi)->dr, buffers[active_buffer], buffer_length, true);
+
+    transfer_in_progress = true;
+    active_buffer = !active_buffer;
+    buffer_length = 0;
+}
+
+static void _shift_register_queue(uint8_t output) {
+    if (buffer_length == SHIFT_REGISTER_BUFFER_LENGTH) {
+        _shift_register_flush();
+    }
+    buffers[active_buffer][buffer_length++] = output;
+    last_output = output;
+}
+
+static void _shift_register_queue_nibble(bool rs_value, uint8_t nibble) {
+    uint8_t output = (nibble << 4) | backlight_bit | (rs_value ? SHIFT_REGISTER_RS_BIT : 0);
+    if ((output ^ last_output) & SHIFT_REGISTER_RS_BIT) {
+        // RS must be stable before enable goes high
+        _shift_register_queue(output);
+    }
+    // Data lines change with enable going high, the display only reads them when it goes low
+    _shift_register_queue(output | SHIFT_REGISTER_E_BIT);
+    _shift_register_queue(output);
+}
+
+/*
+* Repeat the current output for long enough to cover the given delay.
+* already_sent is the number of bytes that will be sent anyway before the next enable cycle.
+*/
+static void _shift_register_queue_padding(uint32_t us, uint32_t already_sent) {
+    uint32_t bytes = (us * 1000 + byte_time_ns - 1) / byte_time_ns;
+    for (uint32_t i = already_sent; i < bytes; i++) {
+        _shift_register_queue(last_output);
+    }
+}
+
+static void _shift_register_write(bool rs_value, uint8_t data) {
+    _shift_register_queue_nibble(rs_value, data >> 4);
+    _shift_register_queue_nibble(rs_value, data & 0b1111);
+    // The next byte is latched two bytes from now at the earliest
+    _shift_register_queue_padding(LCD_SHORT_SLEEP_US, 2);
+}
+
+static void _shift_register_write_nibble(bool rs_value, uint8_t nibble) {
+    _shift_register_queue_nibble(rs_value, nibble);
+    _shift_register_queue_padding(LCD_SHORT_SLEEP_US, 2);
+}
+
+static void _shift_register_delay(uint32_t us) {
+    if (us <= LCD_LONG_SLEEP_US) {
+        // Short enough to send as padding, so the CPU doesn't need to wait
+        _shift_register_queue_padding(us, 0);
+        return;
+    }
+    // Power on and reset delays would take too much padding, just wait for them instead
+    _shift_register_flush();
+    _shift_register_wait_for_transfer();
+    sleep_us(us);
+}
+
+static void _shift_register_set_backlight(bool power) {
+    backlight_bit = power ? SHIFT_REGISTER_BACKLIGHT_BIT : 0;
+    _shift_register_queue((last_output & ~SHIFT_REGISTER_BACKLIGHT_BIT) | backlight_bit);
+}
+
+void lcd_init_74hc595(void) {
+    uint baudrate = spi_init(spi, LCD_SPI_BAUDRATE);
+    // With CPHA 0, chip select goes high between every byte, latching it into the outputs
+    spi_set_format(spi, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+    gpio_set_function(LCD_SPI_SCK_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(LCD_SPI_TX_PIN, GPIO_FUNC_SPI);
+    gpio_set_function(LCD_SPI_LATCH_PIN, GPIO_FUNC_SPI);
+
+    byte_time_ns = (uint32_t)(8 * 1000000000ull / baudrate);
+
+    dma_channel = dma_claim_unused_channel(true);
+    dma_config = dma_channel_get_default_config(dma_channel);
+    channel_config_set_transfer_data_size(&dma_config, DMA_SIZE_8);
+    channel_config_set_read_increment(&dma_config, true);
+    channel_config_set_write_increment(&dma_config, false);
+    channel_config_set_dreq(&dma_config, spi_get_dreq(spi, true));
+
+    // Shift register outputs are undefined on power up, which could leave enable high
+    _shift_register_queue(backlight_bit);
+    _shift_register_flush();
+
+    _lcd_set_bus(&shift_register_bus);
+}
@@ -0,0 +1,140 @@
+#include "pico/stdlib.h"
+
+#include "lcd_bus.h"
+#include "lcd_controller.h"
+
+static uint32_t data_pin_mask = LCD_DATA_PIN_ALL;
+static bool data_direction_out = false;
+
+static void _lcd_gpio_write(bool rs_value, uint8_t data);
+static void _lcd_gpio_write_nibble(bool rs_value, uint8_t nibble);
+static uint8_t _lcd_gpio_read(bool rs_value);
+static void _lcd_gpio_delay(uint32_t us);
+
+static struct LCDBus gpio_bus = {
+    .interface = LCD_INTERFACE_8BIT,
+    .write = _lcd_gpio_write,
+    .write_nibble = _lcd_gpio_write_nibble,
+    .read = _lcd_gpio_read,
+    .delay = _lcd_gpio_delay,
+    .flush = NULL,
+    .set_backlight = NULL
+};
+
+/*
+* Toggle the enable pin on then off.
+*/
+static void _lcd_cycle_enable_line(void) {
+    gpio_put(LCD_E_PIN, true);
+    sleep_us(1);
+    gpio_put(LCD_E_PIN, false);
+    // Enable must stay low for the rest of the enable cycle time
+    // before the next transfer or nibble can start
+    sleep_us(1);
+}
+
+/*
+* Set the GPIO direction of the data pins. Also sets the RW pin.
+* Does nothing if the pins are already in the requested direction.
+*/
+static void _lcd_set_data_direction(bool out) {
+    // Direction only changes when switching between reading and writing,
+    // so skip the register writes for consecutive transfers of the same kind
+    if (out == data_direction_out) {
+        return;
+    }
+    data_direction_out = out;
+
+    // RW pin is 0 for write, 1 for read
+    gpio_put(LCD_RW_PIN, !out);
+    // Set direction of all data pins at once
+    if (out) {
+        gpio_set_dir_out_masked(data_pin_mask);
+    } else {
+        gpio_set_dir_in_masked(data_pin_mask);
+    }
+}
+
+static uint8_t _lcd_read_data_pins(void) {
+    gpio_put(LCD_E_PIN, true);
+    sleep_us(1);
+    uint8_t data = (gpio_get_all() & data_pin_mask) >> LCD_DATA_PIN_START;
+    gpio_put(LCD_E_PIN, false);
+    sleep_us(1);
+    return data;
+}
+
+static void _lcd_gpio_write(bool rs_value, uint8_t data) {
+    gpio_put(LCD_LED_PIN, true);
+
+    _lcd_set_data_direction(GPIO_OUT);
+    gpio_put(LCD_RS_PIN, rs_value);
+    if (gpio_bus.interface == LCD_INTERFACE_4BIT) {
+        gpio_put_masked(data_pin_mask, (uint32_t)(data & 0b11110000) << LCD_DATA_PIN_START);
+        _lcd_cycle_enable_line();
+        gpio_put_masked(data_pin_mask, (uint32_t)(data << 4 & 0b11110000) << LCD_DATA_PIN_START);
+    } else {
+        gpio_put_masked(data_pin_mask, (uint32_t)data << LCD_DATA_PIN_START);
+    }
+    _lcd_cycle_enable_line();
+
+    // No need to wait for the instruction to finish here,
+    // the busy flag is checked before the next transfer
+    gpio_put(LCD_LED_PIN, false);
+}
+
+static void _lcd_gpio_write_nibble(bool rs_value, uint8_t nibble) {
+    _lcd_set_data_direction(GPIO_OUT);
+    gpio_put(LCD_RS_PIN, rs_value);
+    // In 8-bit mode, the lower data pins are ignored by instructions sent this way
+    gpio_put_masked(data_pin_mask, (uint32_t)(nibble << 4) << LCD_DATA_PIN_START);
+    _lcd_cycle_enable_line();
+}
+
+static uint8_t _lcd_gpio_read(bool rs_value) {
+    gpio_put(LCD_LED_PIN, true);
+
+    _lcd_set_data_direction(GPIO_IN);
+    gpio_put(LCD_RS_PIN, rs_value);
+
+    uint8_t data = _lcd_read_data_pins();
+    if (gpio_bus.interface == LCD_INTERFACE_4BIT) {
+        // Both nibbles must always be read to keep the display in step,
+        // even when only the busy flag in the upper nibble is needed
+        data = (data & 0b11110000) | (_lcd_read_data_pins() >> 4);
+    }
+
+    gpio_put(LCD_LED_PIN, false);
+
+    return data;
+}
+
+static void _lcd_gpio_delay(uint32_t us) {
+    sleep_us(us);
+}
+
+void lcd_init_gpio(enum LCDInterface interface) {
+    gpio_bus.interface = interface;
+    data_pin_mask = interface == LCD_INTERFACE_4BIT ? LCD_DATA_PIN_UPPER : LCD_DATA_PIN_ALL;
+    // Data pins start as inputs after being initialised
+    data_direction_out = false;
+
+    gpio_init(LCD_RS_PIN);
+    gpio_init(LCD_RW_PIN);
+    gpio_init(LCD_E_PIN);
+    // Initialise all data pins at once
+    gpio_init_mask(data_pin_mask);
+    gpio_init(LCD_LED_PIN);
+
+    gpio_set_dir(LCD_RS_PIN, GPIO_OUT);
+    gpio_set_dir(LCD_RW_PIN, GPIO_OUT);
+    gpio_set_dir(LCD_E_PIN, GPIO_OUT);
+    gpio_set_dir(LCD_LED_PIN, GPIO_OUT);
+
+    // RW pin must match the initial data pin direction (read)
+    gpio_put(LCD_RW_PIN, true);
+
+    _lcd_pwm_backlight_init();
+
+    _lcd_set_bus(&gpio_bus);
+}
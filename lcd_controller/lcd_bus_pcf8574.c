@@ -0,0 +1,184 @@
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/i2c.h"
+
+#include "lcd_bus.h"
+#include "lcd_controller.h"
+
+// Backpack wiring: P0 = RS, P1 = RW, P2 = E, P3 = backlight, P7-P4 = D7-D4.
+// RW is always held low, as the display is never read through the backpack.
+#define PCF8574_RS_BIT 0b1
+#define PCF8574_E_BIT 0b100
+#define PCF8574_BACKLIGHT_BIT 0b1000
+
+// Enough for a full 20x4 refresh (80 characters and 4 addresses) in a single transfer,
+// with room for the padding needed at slower bus speeds
+#define PCF8574_BUFFER_LENGTH 1024
+
+// An I2C byte takes 9 clock cycles including the acknowledge bit
+#define PCF8574_BITS_PER_BYTE 9
+
+static void _pcf8574_write(bool rs_value, uint8_t data);
+static void _pcf8574_write_nibble(bool rs_value, uint8_t nibble);
+static void _pcf8574_delay(uint32_t us);
+static void _pcf8574_flush(void);
+static void _pcf8574_set_backlight(bool power);
+
+static const struct LCDBus pcf8574_bus = {
+    .interface = LCD_INTERFACE_4BIT,
+    .write = _pcf8574_write,
+    .write_nibble = _pcf8574_write_nibble,
+    .read = NULL,
+    .delay = _pcf8574_delay,
+    .flush = _pcf8574_flush,
+    .set_backlight = _pcf8574_set_backlight
+};
+
+static i2c_inst_t *const i2c = LCD_I2C_INSTANCE;
+
+static int dma_channel;
+static dma_channel_config dma_config;
+
+// Writes are queued into one buffer while the other is being sent by DMA.
+// Each entry is written straight to the I2C data/command register.
+static uint16_t buffers[2][PCF8574_BUFFER_LENGTH];
+static int active_buffer = 0;
+static size_t buffer_length = 0;
+// Number of entries in the transfer currently being sent, 0 if there isn't one
+static size_t transfer_length = 0;
+
+static uint32_t byte_time_us;
+// Extra expander writes needed after each byte to give the display time to execute it
+static uint32_t padding_bytes;
+
+static uint8_t backlight_bit = PCF8574_BACKLIGHT_BIT;
+static uint8_t last_output;
+
+static void _pcf8574_wait_for_transfer(void) {
+    if (transfer_length == 0) {
+        return;
+    }
+
+    uint64_t deadline = time_us_64() + transfer_length * byte_time_us + LCD_BUSY_TIMEOUT_US;
+    while (true) {
+        uint32_t status = i2c_get_hw(i2c)->raw_intr_stat;
+        if (status & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+            // The backpack didn't respond. The hardware discards the rest of the queued
+            // data, so stop feeding it more and clear the abort for the next transfer.
+            dma_channel_abort(dma_channel);
+            (void)i2c_get_hw(i2c)->clr_tx_abrt;
+            _lcd_report_bus_error();
+            break;
+        }
+        // Only the final byte has a stop condition, so this marks the end of the whole transfer
+        if (!dma_channel_is_busy(dma_channel) && (status & I2C_IC_RAW_INTR_STAT_STOP_DET_BITS)) {
+            break;
+        }
+        if (time_us_64() >= deadline) {
+            dma_channel_abort(dma_channel);
+            _lcd_report_bus_error();
+            break;
+        }
+    }
+
+    transfer_length = 0;
+}
+
+static void _pcf8574_flush(void) {
+    if (buffer_length == 0) {
+        return;
+    }
+
+    // Only one transfer can be sent at a time
+    _pcf8574_wait_for_transfer();
+
+    uint16_t *buffer = buffers[active_buffer];
+    buffer[buffer_length - 1] |= I2C_IC_DATA_CMD_STOP_BITS;
+    (void)i2c_get_hw(i2c)->clr_stop_det;
+    dma_channel_configure(
+        dma_channel, &dma_config, &i2c_get_hw(i2c)->data_cmd, buffer, buffer_length, true);
+
+    transfer_length = buffer_length;
+    active_buffer = !active_buffer;
+    buffer_length = 0;
+}
+
+static void _pcf8574_queue(uint8_t output) {
+    if (buffer_length == PCF8574_BUFFER_LENGTH) {
+        _pcf8574_flush();
+    }
+    buffers[active_buffer][buffer_length++] = output;
+    last_output = output;
+}
+
+static void _pcf8574_queue_nibble(bool rs_value, uint8_t nibble) {
+    uint8_t output = (nibble << 4) | backlight_bit | (rs_value ? PCF8574_RS_BIT : 0);
+    if ((output ^ last_output) & PCF8574_RS_BIT) {
+        // RS must be stable before enable goes high
+        _pcf8574_queue(output);
+    }
+    // Data lines change with enable going high, the display only reads them when it goes low
+    _pcf8574_queue(output | PCF8574_E_BIT);
+    _pcf8574_queue(output);
+}
+
+static void _pcf8574_queue_padding(void) {
+    for (uint32_t i = 0; i < padding_bytes; i++) {
+        _pcf8574_queue(last_output);
+    }
+}
+
+static void _pcf8574_write(bool rs_value, uint8_t data) {
+    _pcf8574_queue_nibble(rs_value, data >> 4);
+    _pcf8574_queue_nibble(rs_value, data & 0b1111);
+    _pcf8574_queue_padding();
+}
+
+static void _pcf8574_write_nibble(bool rs_value, uint8_t nibble) {
+    _pcf8574_queue_nibble(rs_value, nibble);
+    _pcf8574_queue_padding();
+}
+
+static void _pcf8574_delay(uint32_t us) {
+    // The delay has to start once everything before it has actually been sent
+    _pcf8574_flush();
+    _pcf8574_wait_for_transfer();
+    sleep_us(us);
+}
+
+static void _pcf8574_set_backlight(bool power) {
+    backlight_bit = power ? PCF8574_BACKLIGHT_BIT : 0;
+    _pcf8574_queue((last_output & ~PCF8574_BACKLIGHT_BIT) | backlight_bit);
+}
+
+void lcd_init_pcf8574(uint8_t address) {
+    uint baudrate = i2c_init(i2c, LCD_I2C_BAUDRATE);
+    gpio_set_function(LCD_I2C_SDA_PIN, GPIO_FUNC_I2C);
+    gpio_set_function(LCD_I2C_SCL_PIN, GPIO_FUNC_I2C);
+    gpio_pull_up(LCD_I2C_SDA_PIN);
+    gpio_pull_up(LCD_I2C_SCL_PIN);
+
+    // Target address is normally set by the SDK's blocking transfer methods, which aren't used here
+    i2c_get_hw(i2c)->enable = 0;
+    i2c_get_hw(i2c)->tar = address;
+    i2c_get_hw(i2c)->enable = 1;
+
+    // Each byte is latched when enable goes low, two expander writes after the previous byte,
+    // so only pad if those writes don't already take as long as an instruction does to execute
+    byte_time_us = (PCF8574_BITS_PER_BYTE * 1000000 + baudrate - 1) / baudrate;
+    uint32_t bytes_per_instruction = (LCD_SHORT_SLEEP_US + byte_time_us - 1) / byte_time_us;
+    padding_bytes = bytes_per_instruction > 2 ? bytes_per_instruction - 2 : 0;
+
+    dma_channel = dma_claim_unused_channel(true);
+    dma_config = dma_channel_get_default_config(dma_channel);
+    channel_config_set_transfer_data_size(&dma_config, DMA_SIZE_16);
+    channel_config_set_read_increment(&dma_config, true);
+    channel_config_set_write_increment(&dma_config, false);
+    channel_config_set_dreq(&dma_config, i2c_get_dreq(i2c, true));
+
+    // Expander outputs are all high on power up, which includes enable and RW
+    _pcf8574_queue(backlight_bit);
+    _pcf8574_flush();
+
+    _lcd_set_bus(&pcf8574_bus);
+}
@@ -1,22 +1,53 @@
+#include <string.h>
 #include "pico/stdlib.h"
 
+#include "lcd_bus.h"
 #include "lcd_controller.h"
 
-void _lcd_cycle_enable_line(void) {
-    gpio_put(LCD_E_PIN, true);
-    sleep_us(1);
-    gpio_put(LCD_E_PIN, false);
-}
-
-void _lcd_set_data_direction(bool out) {
-    // RW pin is 0 for write, 1 for read
-    gpio_put(LCD_RW_PIN, !out);
-    // Set direction of all 8 data pins at once
-    if (out) {
-        gpio_set_dir_out_masked(LCD_DATA_PIN_ALL);
-    } else {
-        gpio_set_dir_in_masked(LCD_DATA_PIN_ALL);
-    }
+// The state the display controller is in after its internal reset:
+// 8-bit interface, 1 line, display off, incrementing address.
+static const struct LCDState reset_state = {
+    .initialised = false,
+    .function_set = 0b110000,
+    .display_control = 0b1000,
+    .entry_mode = 0b110,
+    .cgram_selected = false,
+    .address = 0,
+    .display_shift = 0
+};
+
+static struct LCDState state = reset_state;
+static struct LCDHealth health = {0};
+static struct LCDStartupTiming startup_timing = {0};
+
+static bool bus_trace_enabled = false;
+static struct LCDBusTrace bus_trace = {0};
+
+// The bus that the display is connected through, set by one of the lcd_init_* methods
+static const struct LCDBus *bus = NULL;
+// Brightness of backlights switched through the bus, which can only be off or fully on
+static uint8_t bus_backlight_level = 0;
+
+// Set when the display stops responding, cleared once it has been restored
+static bool display_fault = false;
+// The DDRAM address that will be checked by the next call to lcd_check_health
+static uint8_t probe_address = 0;
+
+// Lines of text written in terminal mode. Line n is kept at lines[n % LCD_TERMINAL_HISTORY_LINES].
+static struct {
+    bool enabled;
+    char lines[LCD_TERMINAL_HISTORY_LINES][LCD_SCREEN_MAX_WIDTH];
+    // Number of lines ever started, the last of which is being written to
+    uint32_t line_count;
+    uint8_t column;
+    // Set by \n, so that the next line isn't started until there is something to put on it
+    bool newline_pending;
+    uint8_t scrollback;
+} terminal = {0};
+
+static uint8_t _lcd_shift_period(void) {
+    // Both lines shift together in 2 line mode
+    return state.function_set & 0b1000 ? LCD_TWO_LINE_DDRAM_LENGTH : LCD_ONE_LINE_DDRAM_END + 1;
 }
 
 uint8_t _lcd_get_address(void) {
@@ -31,48 +62,415 @@ void _lcd_set_cgram_address(uint8_t address) {
     lcd_transmit_data(false, 0b1000000 | address);
 }
 
-void lcd_init_gpio(void) {
-    gpio_init(LCD_RS_PIN);
-    gpio_init(LCD_RW_PIN);
-    gpio_init(LCD_E_PIN);
-    // Initialise all 8 data pins at once
-    gpio_init_mask(LCD_DATA_PIN_ALL);
-    gpio_init(LCD_A_PIN);
-    gpio_init(LCD_LED_PIN);
+static uint32_t _lcd_terminal_available_lines(void) {
+    return terminal.line_count < LCD_TERMINAL_HISTORY_LINES ? terminal.line_count : LCD_TERMINAL_HISTORY_LINES;
+}
 
-    gpio_set_dir(LCD_RS_PIN, GPIO_OUT);
-    gpio_set_dir(LCD_RW_PIN, GPIO_OUT);
-    gpio_set_dir(LCD_E_PIN, GPIO_OUT);
-    gpio_set_dir(LCD_A_PIN, GPIO_OUT);
-    gpio_set_dir(LCD_LED_PIN, GPIO_OUT);
+void _lcd_terminal_reset(void) {
+    terminal.scrollback = 0;
+    memset(terminal.lines[0], ' ', LCD_SCREEN_MAX_WIDTH);
+    terminal.line_count = 1;
+    terminal.column = 0;
+    terminal.newline_pending = false;
 }
 
-bool lcd_is_busy(void) {
-    return (lcd_receive_data(false, false) & 0b10000000) >> 7;
+void _lcd_terminal_new_line(struct LCDSize size) {
+    memset(terminal.lines[terminal.line_count % LCD_TERMINAL_HISTORY_LINES], ' ', LCD_SCREEN_MAX_WIDTH);
+    terminal.line_count++;
+    terminal.column = 0;
+    terminal.newline_pending = false;
+
+    if (terminal.scrollback != 0 && terminal.scrollback < lcd_terminal_get_max_scrollback(size)) {
+        // Keep the same lines on the screen while they are being looked at
+        terminal.scrollback++;
+    }
 }
 
-uint8_t lcd_receive_data(bool rs_value, bool wait_for_not_busy) {
-    while (wait_for_not_busy && lcd_is_busy()) { }
+void _lcd_terminal_write(struct LCDSize size, const char *message) {
+    for (const char *p = message; *p != 0; p++) {
+        if (*p == '\n') {
+            if (terminal.newline_pending) {
+                // Blank line
+                _lcd_terminal_new_line(size);
+            }
+            terminal.newline_pending = true;
+            continue;
+        }
+
+        if (terminal.newline_pending || terminal.column >= size.width) {
+            _lcd_terminal_new_line(size);
+        }
+        terminal.lines[(terminal.line_count - 1) % LCD_TERMINAL_HISTORY_LINES][terminal.column++] = *p;
+    }
+
+    _lcd_terminal_render(size);
+}
 
-    gpio_put(LCD_LED_PIN, true);
+uint32_t _lcd_terminal_top_line(struct LCDSize size) {
+    uint32_t available = _lcd_terminal_available_lines();
+    if (available <= size.height) {
+        // Fill the screen from the top until there are enough lines to scroll
+        return terminal.line_count - available;
+    }
+    return terminal.line_count - size.height - terminal.scrollback;
+}
 
-    _lcd_set_data_direction(GPIO_IN);
-    gpio_put(LCD_RS_PIN, rs_value);
+void _lcd_terminal_render(struct LCDSize size) {
+    char blank[LCD_SCREEN_MAX_WIDTH];
+    memset(blank, ' ', LCD_SCREEN_MAX_WIDTH);
+
+    uint32_t top_line = _lcd_terminal_top_line(size);
+    for (uint8_t y = 0; y < size.height; y++) {
+        uint32_t line = top_line + y;
+        const char *characters = line < terminal.line_count
+            ? terminal.lines[line % LCD_TERMINAL_HISTORY_LINES]
+            : blank;
+        lcd_update(size, (struct LCDPosition){.line = y, .offset = 0}, characters, size.width);
+    }
 
-    gpio_put(LCD_E_PIN, true);
-    sleep_us(1);
-    uint8_t data = (gpio_get_all() & LCD_DATA_PIN_ALL) >> LCD_DATA_PIN_START;
-    gpio_put(LCD_E_PIN, false);
+    if (terminal.scrollback == 0) {
+        // Leave the cursor where the next character will go, in case it is visible
+        struct LCDPosition position = {
+            .line = terminal.line_count - 1 - top_line,
+            .offset = terminal.column < size.width ? terminal.column : size.width - 1
+        };
+        uint8_t address = _lcd_get_position_address(size, position);
+        if (state.cgram_selected || state.address != address) {
+            _lcd_set_ddram_address(address);
+        }
+    }
+}
 
-    sleep_us(LCD_SHORT_SLEEP_US);
-    gpio_put(LCD_LED_PIN, false);
+uint8_t _lcd_get_position_address(struct LCDSize size, struct LCDPosition position) {
+    uint8_t address = position.offset;
+    if (position.line % 2 != 0) {
+        address += LCD_SECOND_LINE_DDRAM;
+    }
+    if (position.line >= 2) {
+        address += size.width;
+    }
+    return address;
+}
 
-    return data;
+static void _lcd_trace_bus_write(void) {
+    if (!bus_trace_enabled) {
+        return;
+    }
+    bus_trace.last_write_us = time_us_64();
+    if (bus_trace.writes++ == 0) {
+        bus_trace.first_write_us = bus_trace.last_write_us;
+    }
 }
 
-struct LCDPosition lcd_get_cursor_position(struct LCDSize size) {
-    uint8_t address = _lcd_get_address();
+void _lcd_set_bus(const struct LCDBus *new_bus) {
+    bus = new_bus;
+    // Backpacks and shift registers start with the backlight on
+    bus_backlight_level = LCD_BACKLIGHT_MAX_LEVEL;
+}
+
+void _lcd_report_bus_error(void) {
+    health.bus_errors++;
+    display_fault = true;
+}
+
+void _lcd_bus_write_nibble(bool rs_value, uint8_t nibble) {
+    bus->write_nibble(rs_value, nibble);
+    _lcd_trace_bus_write();
+}
+
+bool _lcd_run_init_sequence(uint8_t function_set) {
+    bool four_bit = !(function_set & 0b10000);
+    enum LCDInitStep step = LCD_INIT_POWER_ON;
+
+    while (step != LCD_INIT_DONE) {
+        // Delays before the busy flag is valid go through the bus,
+        // so that buses which queue writes wait after the queued writes are sent
+        switch (step) {
+            case LCD_INIT_POWER_ON: {
+                uint64_t now = time_us_64();
+                if (now < LCD_POWER_ON_DELAY_US) {
+                    bus->delay(LCD_POWER_ON_DELAY_US - now);
+                }
+                step = LCD_INIT_RESET_1;
+                break;
+            }
+            case LCD_INIT_RESET_1:
+                _lcd_bus_write_nibble(false, 0b0011);
+                bus->delay(LCD_FIRST_RESET_DELAY_US);
+                step = LCD_INIT_RESET_2;
+                break;
+            case LCD_INIT_RESET_2:
+                _lcd_bus_write_nibble(false, 0b0011);
+                bus->delay(LCD_SECOND_RESET_DELAY_US);
+                step = LCD_INIT_RESET_3;
+                break;
+            case LCD_INIT_RESET_3:
+                _lcd_bus_write_nibble(false, 0b0011);
+                step = four_bit ? LCD_INIT_SELECT_INTERFACE : LCD_INIT_FUNCTION_SET;
+                break;
+            case LCD_INIT_SELECT_INTERFACE:
+                // Still in 8-bit mode, so only the upper nibble is sent
+                if (!_lcd_wait_until_ready()) {
+                    return false;
+                }
+                _lcd_bus_write_nibble(false, 0b0010);
+                step = LCD_INIT_FUNCTION_SET;
+                break;
+            case LCD_INIT_FUNCTION_SET:
+                if (!_lcd_send(false, function_set)) {
+                    return false;
+                }
+                step = LCD_INIT_DISPLAY_OFF;
+                break;
+            case LCD_INIT_DISPLAY_OFF:
+                if (!_lcd_send(false, 0b1000)) {
+                    return false;
+                }
+                step = LCD_INIT_CLEAR;
+                break;
+            case LCD_INIT_CLEAR:
+                if (!_lcd_send(false, 1)) {
+                    return false;
+                }
+                step = LCD_INIT_ENTRY_MODE;
+                break;
+            case LCD_INIT_ENTRY_MODE:
+                // Increment address, don't shift display
+                if (!_lcd_send(false, 0b110)) {
+                    return false;
+                }
+                step = LCD_INIT_DONE;
+                break;
+            case LCD_INIT_DONE:
+                break;
+        }
+    }
+
+    return true;
+}
+
+bool _lcd_wait_until_ready(void) {
+    if (bus->read == NULL) {
+        // Buses that can't read the busy flag space out writes themselves
+        return true;
+    }
+
+    uint64_t deadline = time_us_64() + LCD_BUSY_TIMEOUT_US;
+    while (lcd_is_busy()) {
+        if (time_us_64() >= deadline) {
+            health.busy_timeouts++;
+            display_fault = true;
+            return false;
+        }
+    }
+    return true;
+}
+
+void _lcd_bus_write(bool rs_value, uint8_t data) {
+    bus->write(rs_value, data);
+    _lcd_trace_bus_write();
+
+    if (bus->read == NULL && !rs_value && data != 0 && data < 0b100) {
+        // Clear and return home take much longer than other instructions,
+        // and without the busy flag there's no way to know when they've finished
+        bus->delay(LCD_LONG_SLEEP_US);
+    }
+}
+
+// Answer a read from the stored state instead of the display, with the busy flag always clear
+static uint8_t _lcd_read_stored_state(bool rs_value) {
+    if (!rs_value) {
+        return state.address;
+    }
+    return state.cgram_selected ? state.cgram[state.address] : state.ddram[state.address];
+}
+
+uint8_t _lcd_bus_read(bool rs_value) {
+    if (bus->read == NULL) {
+        return _lcd_read_stored_state(rs_value);
+    }
+
+    // Queued writes have to reach the display before anything can be read back
+    lcd_flush();
+    return bus->read(rs_value);
+}
 
+bool _lcd_send(bool rs_value, uint8_t data) {
+    if (!_lcd_wait_until_ready()) {
+        return false;
+    }
+    _lcd_bus_write(rs_value, data);
+    return true;
+}
+
+uint8_t _lcd_next_address(bool cgram, uint8_t address, bool increment) {
+    if (cgram) {
+        return (address + (increment ? 1 : -1)) & (LCD_CGRAM_SIZE - 1);
+    }
+    if (state.function_set & 0b1000) {
+        // In 2 line mode, the end of each line wraps to the start of the other
+        uint8_t first_line_end = LCD_TWO_LINE_DDRAM_LENGTH - 1;
+        uint8_t second_line_end = LCD_SECOND_LINE_DDRAM + LCD_TWO_LINE_DDRAM_LENGTH - 1;
+        if (increment && address == first_line_end) {
+            return LCD_SECOND_LINE_DDRAM;
+        }
+        if (increment && address == second_line_end) {
+            return 0;
+        }
+        if (!increment && address == LCD_SECOND_LINE_DDRAM) {
+            return first_line_end;
+        }
+        if (!increment && address == 0) {
+            return second_line_end;
+        }
+    } else {
+        if (increment && address == LCD_ONE_LINE_DDRAM_END) {
+            return 0;
+        }
+        if (!increment && address == 0) {
+            return LCD_ONE_LINE_DDRAM_END;
+        }
+    }
+    return address + (increment ? 1 : -1);
+}
+
+void _lcd_track_transmit(bool rs_value, uint8_t data) {
+    if (rs_value) {
+        if (state.cgram_selected) {
+            state.cgram[state.address] = data;
+        } else {
+            state.ddram[state.address] = data;
+            if (state.entry_mode & 1) {
+                // Display shifts with each write, in the opposite direction to the cursor
+                state.display_shift = (state.entry_mode & 0b10)
+                    ? (state.display_shift + _lcd_shift_period() - 1) % _lcd_shift_period()
+                    : (state.display_shift + 1) % _lcd_shift_period();
+            }
+        }
+        state.address = _lcd_next_address(
+            state.cgram_selected, state.address, state.entry_mode & 0b10);
+        return;
+    }
+
+    // Decode instruction by its highest set bit
+    if (data & 0b10000000) {
+        state.cgram_selected = false;
+        state.address = data & 0b1111111;
+    } else if (data & 0b1000000) {
+        state.cgram_selected = true;
+        state.address = data & 0b111111;
+    } else if (data & 0b100000) {
+        state.function_set = data;
+    } else if (data & 0b10000) {
+        bool left_right = data & 0b100;
+        if (data & 0b1000) {
+            state.display_shift = left_right
+                ? (state.display_shift + 1) % _lcd_shift_period()
+                : (state.display_shift + _lcd_shift_period() - 1) % _lcd_shift_period();
+        } else {
+            state.address = _lcd_next_address(state.cgram_selected, state.address, left_right);
+        }
+    } else if (data & 0b1000) {
+        state.display_control = data;
+    } else if (data & 0b100) {
+        state.entry_mode = data;
+    } else if (data & 0b10) {
+        state.cgram_selected = false;
+        state.address = 0;
+        state.display_shift = 0;
+    } else if (data & 1) {
+        memset(state.ddram, ' ', LCD_DDRAM_SIZE);
+        state.cgram_selected = false;
+        state.address = 0;
+        state.display_shift = 0;
+        // Clearing the display always sets the address to increment
+        state.entry_mode |= 0b10;
+    }
+}
+
+void _lcd_track_receive(bool rs_value) {
+    // Only data reads move the address counter
+    if (rs_value) {
+        state.address = _lcd_next_address(
+            state.cgram_selected, state.address, state.entry_mode & 0b10);
+    }
+}
+
+bool _lcd_replay_state(const struct LCDState *saved) {
+    // Keep the display off while it is being filled,
+    // and write without shifting so addresses increment predictably
+    if (!_lcd_send(false, saved->function_set)
+            || !_lcd_send(false, 0b1000)
+            || !_lcd_send(false, 0b110)
+            || !_lcd_send(false, 0b1000000)) {
+        return false;
+    }
+    for (int i = 0; i < LCD_CGRAM_SIZE; i++) {
+        if (!_lcd_send(true, saved->cgram[i])) {
+            return false;
+        }
+    }
+
+    if (saved->function_set & 0b1000) {
+        uint8_t line_starts[2] = {0, LCD_SECOND_LINE_DDRAM};
+        for (int line = 0; line < 2; line++) {
+            if (!_lcd_send(false, 0b10000000 | line_starts[line])) {
+                return false;
+            }
+            for (int i = 0; i < LCD_TWO_LINE_DDRAM_LENGTH; i++) {
+                if (!_lcd_send(true, saved->ddram[line_starts[line] + i])) {
+                    return false;
+                }
+            }
+        }
+    } else {
+        if (!_lcd_send(false, 0b10000000)) {
+            return false;
+        }
+        for (int i = 0; i <= LCD_ONE_LINE_DDRAM_END; i++) {
+            if (!_lcd_send(true, saved->ddram[i])) {
+                return false;
+            }
+        }
+    }
+
+    for (int i = 0; i < saved->display_shift; i++) {
+        // Shift display right
+        if (!_lcd_send(false, 0b11100)) {
+            return false;
+        }
+    }
+
+    uint8_t address_instruction = saved->cgram_selected
+        ? 0b1000000 | saved->address
+        : 0b10000000 | saved->address;
+    return _lcd_send(false, saved->entry_mode)
+        && _lcd_send(false, address_instruction)
+        && _lcd_send(false, saved->display_control);
+}
+
+bool lcd_is_busy(void) {
+    return (lcd_receive_data(false, false) & 0b10000000) >> 7;
+}
+
+uint8_t lcd_receive_data(bool rs_value, bool wait_for_not_busy) {
+    uint8_t data;
+    if (display_fault) {
+        // Waiting on a display that isn't responding would hold up everything else,
+        // so answer from the stored state until lcd_check_health has restored it
+        data = _lcd_read_stored_state(rs_value);
+    } else {
+        if (wait_for_not_busy) {
+            _lcd_wait_until_ready();
+        }
+        data = _lcd_bus_read(rs_value);
+    }
+    _lcd_track_receive(rs_value);
+
+    return data;
+}
+
+static struct LCDPosition _lcd_get_address_position(struct LCDSize size, uint8_t address) {
     uint8_t mod_second_line = address % LCD_SECOND_LINE_DDRAM;
     uint8_t line;
     if (mod_second_line >= size.width) {
@@ -87,12 +485,32 @@ struct LCDPosition lcd_get_cursor_position(struct LCDSize size) {
     };
 }
 
+struct LCDPosition lcd_get_cursor_position(struct LCDSize size) {
+    return _lcd_get_address_position(size, _lcd_get_address());
+}
+
 void lcd_read(struct LCDSize size, char *string) {
+    int characters_per_line = size.width + 1;
+
+    if (terminal.enabled) {
+        // History already holds custom characters as 1-indexed
+        uint32_t top_line = _lcd_terminal_top_line(size);
+        for (int y = 0; y < size.height; y++) {
+            char *line = &string[y * characters_per_line];
+            if (top_line + y < terminal.line_count) {
+                memcpy(line, terminal.lines[(top_line + y) % LCD_TERMINAL_HISTORY_LINES], size.width);
+            } else {
+                memset(line, ' ', size.width);
+            }
+            line[size.width] = '\n';
+        }
+        string[size.height * characters_per_line - 1] = '\0';
+        return;
+    }
+
     // Store old DDRAM address to return to later
     uint8_t old_address = _lcd_get_address();
 
-    int characters_per_line = size.width + 1;
-
     for (int y = 0; y < size.height; y++) {
         lcd_set_cursor_position(size,
             (struct LCDPosition){.line = y, .offset = 0});
@@ -115,6 +533,26 @@ void lcd_read(struct LCDSize size, char *string) {
     _lcd_set_ddram_address(old_address);
 }
 
+void lcd_read_stored(struct LCDSize size, char *string, struct LCDPosition *cursor) {
+    int characters_per_line = size.width + 1;
+    for (int y = 0; y < size.height; y++) {
+        for (int x = 0; x < size.width; x++) {
+            uint8_t data = state.ddram[_lcd_get_position_address(size, (struct LCDPosition){.line = y, .offset = x})];
+            if (data <= 7) {
+                // Convert 0-indexed custom character to 1-indexed
+                ++data;
+            }
+            string[y * characters_per_line + x] = data;
+        }
+        string[y * characters_per_line + size.width] = '\n';
+    }
+    string[size.height * characters_per_line - 1] = '\0';
+
+    *cursor = state.cgram_selected
+        ? (struct LCDPosition){.line = 0, .offset = 0}
+        : _lcd_get_address_position(size, state.address);
+}
+
 void lcd_get_custom_char(uint8_t char_number, uint8_t pixels[static 8]) {
     // Store old DDRAM address to return to later
     uint8_t old_address = _lcd_get_address();
@@ -132,27 +570,51 @@ void lcd_get_custom_char(uint8_t char_number, uint8_t pixels[static 8]) {
 }
 
 void lcd_transmit_data(bool rs_value, uint8_t data) {
-    while (lcd_is_busy()) { }
-
-    gpio_put(LCD_LED_PIN, true);
-
-    _lcd_set_data_direction(GPIO_OUT);
-    uint32_t gpio_data = (uint32_t)data << LCD_DATA_PIN_START;
-    gpio_put(LCD_RS_PIN, rs_value);
-    gpio_put_masked(LCD_DATA_PIN_ALL, gpio_data);
-    _lcd_cycle_enable_line();
+    // Keep track of the state even if the display isn't responding,
+    // so it can be restored once the display has been recovered.
+    // Nothing is sent until then, as each write would wait out the full busy timeout.
+    if (!display_fault) {
+        _lcd_send(rs_value, data);
+    }
+    _lcd_track_transmit(rs_value, data);
 
-    sleep_us(LCD_SHORT_SLEEP_US);
-    gpio_put(LCD_LED_PIN, false);
+    if (rs_value && !state.cgram_selected
+            && startup_timing.init_done_us != 0 && startup_timing.first_write_us == 0) {
+        startup_timing.first_write_us = time_us_64();
+    }
 }
 
 void lcd_clear(void) {
+    if (terminal.enabled) {
+        _lcd_terminal_reset();
+    }
     lcd_transmit_data(false, 1);
 }
 
 void lcd_initialise_display(bool lines, bool font) {
-    lcd_transmit_data(false, 0b110000 | (lines << 3) | (font << 2));
-    lcd_clear();
+    uint8_t function_set = 0b100000 | (lines << 3) | (font << 2);
+    if (bus->interface == LCD_INTERFACE_8BIT) {
+        function_set |= 0b10000;
+    }
+
+    state = reset_state;
+    state.initialised = true;
+    display_fault = false;
+
+    uint64_t start_time = time_us_64();
+    if (!_lcd_run_init_sequence(function_set)) {
+        display_fault = true;
+    } else if (startup_timing.init_done_us == 0) {
+        startup_timing.init_start_us = start_time;
+        startup_timing.init_done_us = time_us_64();
+    }
+
+    _lcd_track_transmit(false, function_set);
+    _lcd_track_transmit(false, 0b1000);
+    _lcd_track_transmit(false, 1);
+    _lcd_track_transmit(false, 0b110);
+
+    lcd_flush();
 }
 
 void lcd_display_set(bool display, bool cursor, bool blink) {
@@ -166,27 +628,61 @@ void lcd_scroll(bool cursor_screen, bool left_right) {
 
 void lcd_home(void) {
     lcd_transmit_data(false, 0b10);
-
-    gpio_put(LCD_LED_PIN, true);
-    sleep_ms(LCD_LONG_SLEEP_MS);
-    gpio_put(LCD_LED_PIN, false);
 }
 
 void lcd_backlight(bool power) {
-    gpio_put(LCD_A_PIN, power);
+    lcd_backlight_fade(power ? LCD_BACKLIGHT_MAX_LEVEL : 0, 0);
 }
 
-void lcd_set_cursor_position(struct LCDSize size, struct LCDPosition position) {
-    if (position.line % 2 != 0) {
-        position.offset += LCD_SECOND_LINE_DDRAM;
+void lcd_backlight_fade(uint8_t level, uint32_t fade_ms) {
+    if (fade_ms > LCD_BACKLIGHT_MAX_FADE_MS) {
+        fade_ms = LCD_BACKLIGHT_MAX_FADE_MS;
     }
-    if (position.line >= 2) {
-        position.offset += size.width;
+
+    if (bus->set_backlight != NULL) {
+        bus->set_backlight(level != 0);
+        bus_backlight_level = level != 0 ? LCD_BACKLIGHT_MAX_LEVEL : 0;
+    } else {
+        _lcd_pwm_backlight_fade(level, fade_ms);
     }
-    _lcd_set_ddram_address(position.offset);
+}
+
+bool lcd_backlight_breathe(uint8_t level, uint32_t period_ms) {
+    if (bus->set_backlight != NULL) {
+        return false;
+    }
+
+    if (period_ms > LCD_BACKLIGHT_MAX_FADE_MS) {
+        period_ms = LCD_BACKLIGHT_MAX_FADE_MS;
+    }
+    _lcd_pwm_backlight_breathe(level, period_ms);
+    return true;
+}
+
+uint8_t lcd_get_backlight_level(void) {
+    return bus->set_backlight != NULL ? bus_backlight_level : _lcd_pwm_backlight_get_level();
+}
+
+void lcd_flush(void) {
+    if (bus->flush != NULL) {
+        bus->flush();
+        // Queued writes only start going out to the display now
+        if (bus_trace_enabled && bus_trace.writes != 0) {
+            bus_trace.last_write_us = time_us_64();
+        }
+    }
+}
+
+void lcd_set_cursor_position(struct LCDSize size, struct LCDPosition position) {
+    _lcd_set_ddram_address(_lcd_get_position_address(size, position));
 }
 
 void lcd_write(struct LCDSize size, const char *message) {
+    if (terminal.enabled) {
+        _lcd_terminal_write(size, message);
+        return;
+    }
+
     uint8_t last_line = lcd_get_cursor_position(size).line;
     for (const char *p = message; *p != 0; p++) {
         char c = *p;
@@ -211,6 +707,135 @@ void lcd_write(struct LCDSize size, const char *message) {
     }
 }
 
+void lcd_update(struct LCDSize size, struct LCDPosition position, const char *characters, uint8_t count) {
+    // Consecutive changed characters only need one address if the address is incrementing
+    uint8_t old_entry_mode = state.entry_mode;
+    if (old_entry_mode != 0b110) {
+        lcd_transmit_data(false, 0b110);
+    }
+
+    uint8_t line_address = _lcd_get_position_address(size,
+        (struct LCDPosition){.line = position.line, .offset = 0});
+    for (int i = 0; i < count && position.offset + i < size.width; i++) {
+        uint8_t data = (uint8_t)characters[i];
+        if (data >= 1 && data <= 8) {
+            // Convert 1-based custom character index to 0-based
+            --data;
+        }
+
+        uint8_t address = line_address + position.offset + i;
+        if (state.ddram[address] == data) {
+            continue;
+        }
+        if (state.cgram_selected || state.address != address) {
+            _lcd_set_ddram_address(address);
+        }
+        lcd_transmit_data(true, data);
+    }
+
+    if (old_entry_mode != 0b110) {
+        lcd_transmit_data(false, old_entry_mode);
+    }
+}
+
+bool lcd_write_box(struct LCDSize size, struct LCDPosition position, struct LCDSize box,
+    enum LCDAlignment alignment, const char *message) {
+    // Clip the box to the screen
+    if (position.line >= size.height || position.offset >= size.width) {
+        return *message == 0;
+    }
+    if (box.height > size.height - position.line) {
+        box.height = size.height - position.line;
+    }
+    if (box.width > size.width - position.offset) {
+        box.width = size.width - position.offset;
+    }
+
+    char lines[LCD_SCREEN_MAX_HEIGHT][LCD_SCREEN_MAX_WIDTH];
+    memset(lines, ' ', sizeof(lines));
+
+    const char *p = message;
+    for (int y = 0; y < box.height && *p != 0; y++) {
+        // Take as much as fits on the line, remembering the last space it could be broken at
+        const char *scan = p;
+        const char *last_space = NULL;
+        while (*scan != 0 && *scan != '\n' && scan - p < box.width) {
+            if (*scan == ' ') {
+                last_space = scan;
+            }
+            scan++;
+        }
+
+        const char *end;
+        const char *next;
+        bool wrapped = true;
+        if (*scan == 0 || *scan == '\n') {
+            // Everything up to the end of the text or line fits
+            end = scan;
+            next = *scan == '\n' ? scan + 1 : scan;
+            wrapped = false;
+        } else if (*scan == ' ') {
+            // Line is full, and ends exactly at the end of a word
+            end = scan;
+            next = scan;
+        } else if (last_space != NULL) {
+            end = last_space;
+            next = last_space;
+        } else {
+            // A single word is too long for the line
+            end = scan;
+            next = scan;
+        }
+        if (wrapped) {
+            // Spaces where a line is broken aren't shown on either line
+            while (*next == ' ') {
+                next++;
+            }
+            // A newline straight after the break has already been taken by the wrap
+            if (*next == '\n') {
+                next++;
+            }
+        }
+        while (end > p && end[-1] == ' ') {
+            end--;
+        }
+
+        int length = end - p;
+        int offset = 0;
+        if (alignment == LCD_ALIGN_CENTRE) {
+            offset = (box.width - length) / 2;
+        } else if (alignment == LCD_ALIGN_RIGHT) {
+            offset = box.width - length;
+        }
+        memcpy(&lines[y][offset], p, length);
+        p = next;
+    }
+
+    // Send lines in order of DDRAM address, so the end of one line can run straight onto the next
+    // (e.g. lines 1 and 3 of a 4 line display are consecutive in DDRAM)
+    uint8_t order[LCD_SCREEN_MAX_HEIGHT];
+    uint8_t addresses[LCD_SCREEN_MAX_HEIGHT];
+    for (int y = 0; y < box.height; y++) {
+        uint8_t address = _lcd_get_position_address(size,
+            (struct LCDPosition){.line = position.line + y, .offset = position.offset});
+        int i = y;
+        while (i > 0 && addresses[i - 1] > address) {
+            addresses[i] = addresses[i - 1];
+            order[i] = order[i - 1];
+            i--;
+        }
+        addresses[i] = address;
+        order[i] = y;
+    }
+    for (int i = 0; i < box.height; i++) {
+        lcd_update(size,
+            (struct LCDPosition){.line = position.line + order[i], .offset = position.offset},
+            lines[order[i]], box.width);
+    }
+
+    return *p == 0;
+}
+
 void lcd_define_custom_char(uint8_t char_number, uint8_t pixels[const static 8]) {
     // Store old DDRAM address to return to later
     // (setting character data requires moving cursor into CGRAM)
@@ -227,3 +852,150 @@ void lcd_define_custom_char(uint8_t char_number, uint8_t pixels[const static 8])
     // Restore DDRAM address
     _lcd_set_ddram_address(old_address);
 }
+
+
+void lcd_set_terminal_mode(struct LCDSize size, bool enabled) {
+    terminal.enabled = enabled;
+    if (enabled) {
+        _lcd_terminal_reset();
+        _lcd_terminal_render(size);
+    }
+}
+
+bool lcd_get_terminal_mode(void) {
+    return terminal.enabled;
+}
+
+void lcd_terminal_scroll(struct LCDSize size, int lines) {
+    int scrollback = terminal.scrollback + lines;
+    int max_scrollback = lcd_terminal_get_max_scrollback(size);
+    if (scrollback < 0) {
+        scrollback = 0;
+    } else if (scrollback > max_scrollback) {
+        scrollback = max_scrollback;
+    }
+
+    terminal.scrollback = (uint8_t)scrollback;
+    _lcd_terminal_render(size);
+}
+
+uint8_t lcd_terminal_get_scrollback(void) {
+    return terminal.scrollback;
+}
+
+uint8_t lcd_terminal_get_max_scrollback(struct LCDSize size) {
+    uint32_t available = _lcd_terminal_available_lines();
+    return available > size.height ? (uint8_t)(available - size.height) : 0;
+}
+
+const struct LCDState *lcd_get_state(void) {
+    return &state;
+}
+
+bool lcd_restore_state(const struct LCDState *new_state) {
+    // new_state may be the stored state itself, so take a copy before it is changed
+    struct LCDState target = *new_state;
+    // The state may have been saved by a build using a different bus, so use this bus's interface width
+    target.function_set &= ~0b10000;
+    if (bus->interface == LCD_INTERFACE_8BIT) {
+        target.function_set |= 0b10000;
+    }
+
+    state = target;
+    display_fault = false;
+
+    uint64_t start_time = time_us_64();
+    if (!_lcd_run_init_sequence(target.function_set)) {
+        display_fault = true;
+        return false;
+    }
+    uint64_t init_done_time = time_us_64();
+
+    if (!_lcd_replay_state(&target)) {
+        display_fault = true;
+        return false;
+    }
+    // Wait for queued writes to be sent, so an error sending them fails the restore
+    lcd_flush();
+    bus->delay(0);
+    if (display_fault) {
+        return false;
+    }
+
+    if (startup_timing.init_done_us == 0) {
+        startup_timing.init_start_us = start_time;
+        startup_timing.init_done_us = init_done_time;
+        // Restoring the display counts as the first write
+        startup_timing.first_write_us = time_us_64();
+    }
+    return true;
+}
+
+static bool _lcd_probe_display(void) {
+    if (!_lcd_wait_until_ready()) {
+        return false;
+    }
+    // A display that has reset itself will have lost its address
+    if ((_lcd_bus_read(false) & 0b1111111) != state.address) {
+        return false;
+    }
+    if (state.cgram_selected) {
+        return true;
+    }
+
+    // Check a different character each time so that, over time,
+    // the whole display is compared against what it should contain
+    probe_address = _lcd_next_address(false, probe_address, true);
+    bool matches = _lcd_send(false, 0b10000000 | probe_address)
+        && _lcd_wait_until_ready()
+        && _lcd_bus_read(true) == state.ddram[probe_address];
+
+    // Return address counter to where it was before the check
+    return _lcd_send(false, 0b10000000 | state.address) && matches;
+}
+
+void lcd_check_health(void) {
+    if (!state.initialised) {
+        return;
+    }
+
+    // Buses report errors once queued writes have been sent, which may not have happened yet
+    lcd_flush();
+    bus->delay(0);
+
+    // Without being able to read from the display, only timeouts and bus errors can reveal a fault
+    if (!display_fault && (bus->read == NULL || _lcd_probe_display())) {
+        return;
+    }
+
+    health.faults_detected++;
+    uint64_t start_time = time_us_64();
+    if (lcd_restore_state(&state)) {
+        health.recoveries++;
+    } else {
+        health.failed_recoveries++;
+    }
+
+    health.last_recovery_us = (uint32_t)(time_us_64() - start_time);
+    if (health.last_recovery_us > health.max_recovery_us) {
+        health.max_recovery_us = health.last_recovery_us;
+    }
+}
+
+struct LCDHealth lcd_get_health(void) {
+    return health;
+}
+
+struct LCDStartupTiming lcd_get_startup_timing(void) {
+    return startup_timing;
+}
+
+void lcd_start_bus_trace(void) {
+    bus_trace = (struct LCDBusTrace){0};
+    bus_trace_enabled = true;
+}
+
+struct LCDBusTrace lcd_stop_bus_trace(void) {
+    bus_trace_enabled = false;
+    return bus_trace;
+}
\ No newline at end of file
@@ -1,3 +1,6 @@
+#ifndef LCD_CONTROLLER_H
+#define LCD_CONTROLLER_H
+
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -5,12 +8,36 @@
 #define LCD_RS_PIN 2
 #define LCD_RW_PIN 13
 #define LCD_E_PIN 3
-// Data GPIO pins must be sequential
+// Data GPIO pins must be sequential.
+// In 4-bit mode only the upper four pins (D7-D4) are used.
 #define LCD_DATA_PIN_START 4
 #define LCD_A_PIN 12
 #define LCD_LED_PIN 25
 
+// Pins and settings for displays connected through a PCF8574 I2C backpack
+#define LCD_I2C_INSTANCE i2c1
+#define LCD_I2C_SDA_PIN 14
+#define LCD_I2C_SCL_PIN 15
+#define LCD_I2C_BAUDRATE 400000
+#define LCD_PCF8574_DEFAULT_ADDRESS 0x27
+
+// Pins and settings for displays connected through a 74HC595 shift register.
+// The latch pin is the SPI chip select pin, connected to the storage register clock.
+#define LCD_SPI_INSTANCE spi0
+#define LCD_SPI_SCK_PIN 18
+#define LCD_SPI_TX_PIN 19
+#define LCD_SPI_LATCH_PIN 17
+#define LCD_SPI_BAUDRATE 1000000
+
+// The backlight on LCD_A_PIN is dimmed with PWM. Fades are timed by a second PWM slice,
+// which must not be the slice of any pin that is used for PWM.
+#define LCD_BACKLIGHT_PACING_PWM_SLICE 7
+// Brightness levels are perceived brightness, corrected for the eye's response to light
+#define LCD_BACKLIGHT_MAX_LEVEL 255
+#define LCD_BACKLIGHT_MAX_FADE_MS 30000
+
 #define LCD_DATA_PIN_ALL 0b11111111 << LCD_DATA_PIN_START
+#define LCD_DATA_PIN_UPPER 0b11110000 << LCD_DATA_PIN_START
 
 #define LCD_SCREEN_MAX_WIDTH 40
 #define LCD_SCREEN_MAX_HEIGHT 4
@@ -20,8 +47,29 @@
 
 #define LCD_SECOND_LINE_DDRAM 0x40
 
+// Lines of text kept in terminal mode, including the ones on the screen
+#define LCD_TERMINAL_HISTORY_LINES 64
+
+// Execution time of most instructions, and of clear and return home
 #define LCD_SHORT_SLEEP_US 37
-#define LCD_LONG_SLEEP_MS 2
+#define LCD_LONG_SLEEP_US 1520
+
+// The slowest instruction (clear display) takes 1.52ms to execute,
+// so a busy flag that is still set after this long means the display has hung
+#define LCD_BUSY_TIMEOUT_US 5000
+
+// Minimum delays from the datasheet's initialisation by instruction sequence.
+// The power on delay is measured from boot, as power reaches the display at the same time.
+#define LCD_POWER_ON_DELAY_US 40000
+#define LCD_FIRST_RESET_DELAY_US 4100
+#define LCD_SECOND_RESET_DELAY_US 100
+
+// DDRAM addresses are 7 bits, CGRAM addresses are 6 bits
+#define LCD_DDRAM_SIZE 128
+#define LCD_CGRAM_SIZE 64
+
+#define LCD_ONE_LINE_DDRAM_END 0x4F
+#define LCD_TWO_LINE_DDRAM_LENGTH 40
 
 struct LCDPosition {
     uint8_t line;
@@ -33,17 +81,85 @@ struct LCDSize {
     uint8_t height;
 };
 
-// INTERNAL METHODS
+enum LCDAlignment {
+    LCD_ALIGN_LEFT,
+    LCD_ALIGN_CENTRE,
+    LCD_ALIGN_RIGHT
+};
 
-/*
-* Toggle the enable pin on then off.
-*/
-void _lcd_cycle_enable_line(void);
+enum LCDInterface {
+    LCD_INTERFACE_8BIT,
+    LCD_INTERFACE_4BIT
+};
+
+enum LCDInitStep {
+    // Wait for power to stabilise
+    LCD_INIT_POWER_ON,
+    // Three function set instructions put the display into a known state,
+    // whichever interface mode it was in beforehand
+    LCD_INIT_RESET_1,
+    LCD_INIT_RESET_2,
+    LCD_INIT_RESET_3,
+    // Switch to the 4-bit interface if required. Busy flag can be used from here on.
+    LCD_INIT_SELECT_INTERFACE,
+    LCD_INIT_FUNCTION_SET,
+    LCD_INIT_DISPLAY_OFF,
+    LCD_INIT_CLEAR,
+    LCD_INIT_ENTRY_MODE,
+    LCD_INIT_DONE
+};
+
+struct LCDBusTrace {
+    // Time since boot of the first and last write to the bus while tracing, 0 if there were none.
+    // On buses that queue writes, the last write is when the queue was last sent.
+    uint64_t first_write_us;
+    uint64_t last_write_us;
+    uint32_t writes;
+};
+
+struct LCDStartupTiming {
+    // Time since boot that the first initialisation of the display started and finished,
+    // 0 if the display has not been initialised yet
+    uint64_t init_start_us;
+    uint64_t init_done_us;
+    // Time since boot that text was first written to the display after initialisation,
+    // 0 if nothing has been written yet
+    uint64_t first_write_us;
+};
 
 /*
-* Set the GPIO direction of the data pins. Also sets the RW pin.
+* Copy of everything the display controller holds, kept up to date
+* by decoding every instruction and data byte sent to the display.
+* Used to restore the display if it resets or hangs.
 */
-void _lcd_set_data_direction(bool out);
+struct LCDState {
+    bool initialised;
+    uint8_t function_set;
+    uint8_t display_control;
+    uint8_t entry_mode;
+    bool cgram_selected;
+    // Current DDRAM or CGRAM address, depending on cgram_selected
+    uint8_t address;
+    // Number of characters the display has been shifted to the right by
+    uint8_t display_shift;
+    uint8_t ddram[LCD_DDRAM_SIZE];
+    uint8_t cgram[LCD_CGRAM_SIZE];
+};
+
+struct LCDHealth {
+    // Number of times the busy flag failed to clear within LCD_BUSY_TIMEOUT_US
+    uint32_t busy_timeouts;
+    // Number of writes the bus reported as not reaching the display
+    uint32_t bus_errors;
+    // Number of times lcd_check_health found the display hung or reset
+    uint32_t faults_detected;
+    uint32_t recoveries;
+    uint32_t failed_recoveries;
+    uint32_t last_recovery_us;
+    uint32_t max_recovery_us;
+};
+
+// INTERNAL METHODS
 
 /*
 * Get the current address counter from the LCD.
@@ -64,12 +180,126 @@ void _lcd_set_ddram_address(uint8_t address);
 */
 void _lcd_set_cgram_address(uint8_t address);
 
-// GPIO INIT METHOD
+/*
+* Get the DDRAM address of a position on the screen.
+*/
+uint8_t _lcd_get_position_address(struct LCDSize size, struct LCDPosition position);
+
+/*
+* Put a 4-bit value on data pins D7-D4 and cycle the enable pin once,
+* without waiting for the display. Used while the interface mode is unknown.
+* Sent through the bus selected by one of the lcd_init_* methods.
+*/
+void _lcd_bus_write_nibble(bool rs_value, uint8_t nibble);
+
+/*
+* Run the full initialisation sequence, ending with the given function set instruction.
+* The interface mode is taken from the data length bit of function_set.
+* Completes in the minimum time allowed by the datasheet, using the busy flag
+* as soon as it becomes valid. Returns false if the display stopped responding.
+* Does not update the stored display state.
+*/
+bool _lcd_run_init_sequence(uint8_t function_set);
+
+/*
+* Wait for the busy flag to clear, giving up after LCD_BUSY_TIMEOUT_US.
+* Returns false and flags the display as faulty if the wait timed out.
+*/
+bool _lcd_wait_until_ready(void);
+
+/*
+* Put an 8-bit value on the data pins and cycle the enable pin
+* (twice, upper nibble first, in 4-bit mode),
+* without waiting for the display or updating the stored display state.
+* On buses that can't read, waits out the execution time of clear and return home.
+*/
+void _lcd_bus_write(bool rs_value, uint8_t data);
+
+/*
+* Read an 8-bit value from the data pins while cycling the enable pin
+* (twice, upper nibble first, in 4-bit mode),
+* without waiting for the display or updating the stored display state.
+* On buses that can't read, the value is taken from the stored display state.
+*/
+uint8_t _lcd_bus_read(bool rs_value);
+
+/*
+* Wait for the display then transmit a value without updating the stored display state.
+* Returns false if the display did not become ready in time.
+*/
+bool _lcd_send(bool rs_value, uint8_t data);
+
+/*
+* Empty the terminal mode history, leaving a single blank line.
+*/
+void _lcd_terminal_reset(void);
+
+/*
+* Start a new line at the bottom of the terminal mode history, discarding the oldest line if it is full.
+*/
+void _lcd_terminal_new_line(struct LCDSize size);
+
+/*
+* Add text to the terminal mode history, then update the screen.
+*/
+void _lcd_terminal_write(struct LCDSize size, const char *message);
+
+/*
+* Get the number of the history line shown on the top line of the screen in terminal mode.
+*/
+uint32_t _lcd_terminal_top_line(struct LCDSize size);
+
+/*
+* Show the current part of the terminal mode history on the screen,
+* only sending the characters that differ from what is already there.
+*/
+void _lcd_terminal_render(struct LCDSize size);
+
+/*
+* Get the address that follows the given DDRAM or CGRAM address,
+* taking into account the line mode of the display.
+*/
+uint8_t _lcd_next_address(bool cgram, uint8_t address, bool increment);
+
+/*
+* Update the stored display state to reflect a value sent to or read from the display.
+*/
+void _lcd_track_transmit(bool rs_value, uint8_t data);
+void _lcd_track_receive(bool rs_value);
+
+/*
+* Send the stored display state back to the display after it has been initialised,
+* so that it matches what it was showing before. Returns false if the display
+* stopped responding part way through.
+*/
+bool _lcd_replay_state(const struct LCDState *state);
+
+// BUS INIT METHODS
+// One of these must be called before any other method.
+
+/*
+* Initialise and set the direction of all required GPIO pins,
+* for a display connected directly to the GPIO pins.
+* interface selects whether all 8 data pins are connected, or only D7-D4.
+*/
+void lcd_init_gpio(enum LCDInterface interface);
 
 /*
-* Initialise and set the direction of all required GPIO pins.
+* Initialise I2C and DMA for a display connected through a PCF8574 I2C backpack
+* at the given 7-bit address. Writes are queued and sent in batches, so
+* lcd_flush must be called once a set of changes has been made.
+* Reading from the display is not supported, reads are answered from the stored display state.
 */
-void lcd_init_gpio(void);
+void lcd_init_pcf8574(uint8_t address);
+
+/*
+* Initialise SPI and DMA for a display connected in 4-bit mode through a 74HC595 shift register,
+* wired the same way as a PCF8574 backpack. Writes are queued and sent in batches, with the
+* time each instruction takes to execute sent as padding, so lcd_flush must be called once
+* a set of changes has been made.
+* The shift register can't read from the display, reads are answered from the stored display state.
+*/
+void lcd_init_74hc595(void);
 
 // RX METHODS
 
@@ -100,9 +330,17 @@ struct LCDPosition lcd_get_cursor_position(struct LCDSize size);
 * String must have enough capacity for (size.width + 1) * size.height.
 * Custom characters are represented by \x01 through \x08 inclusive.
 * Lines are separated by \n.
+* In terminal mode the text is taken from the history instead of the display.
 */
 void lcd_read(struct LCDSize size, char *string);
 
+/*
+* Get the text on the screen and the position of the cursor from the stored display state,
+* in the same format as lcd_read and lcd_get_cursor_position, without reading from the display.
+* The cursor is left at 0, 0 while CGRAM is selected.
+*/
+void lcd_read_stored(struct LCDSize size, char *string, struct LCDPosition *cursor);
+
 /*
 * Retrieve pixels for a defined custom character. Character number can be between 0 and 7.
 * Pixel array must have capacity for 8 uint8_t values. They will be no greater than 0b11111 each.
@@ -121,11 +359,13 @@ void lcd_transmit_data(bool rs_value, uint8_t data);
 
 /*
 * Remove all characters from the display and return cursor to home.
+* In terminal mode the history is also emptied.
 */
 void lcd_clear(void);
 
 /*
-* Initialise the connected display. Must be used before display can be utilised
+* Initialise the connected display. Must be used before display can be utilised.
+* The display is cleared and left turned off.
 * lines: false = 1 line, true = 2 lines
 * font: false = 5x8, true = 5x11
 */
@@ -153,6 +393,33 @@ void lcd_home(void);
 */
 void lcd_backlight(bool power);
 
+/*
+* Fade the backlight to a brightness between 0 and LCD_BACKLIGHT_MAX_LEVEL over fade_ms
+* (at most LCD_BACKLIGHT_MAX_FADE_MS), or change it immediately if fade_ms is 0.
+* The fade runs in the background without using the CPU. Stops any breathing effect.
+* Backlights switched through the bus can only be on or off, so are turned on by any level above 0.
+*/
+void lcd_backlight_fade(uint8_t level, uint32_t fade_ms);
+
+/*
+* Repeatedly fade the backlight up from off to a brightness and back down,
+* taking period_ms (at most LCD_BACKLIGHT_MAX_FADE_MS) for each cycle, in the background.
+* Continues until the next lcd_backlight or lcd_backlight_fade call.
+* Returns false if the backlight is switched through the bus, so can't be dimmed.
+*/
+bool lcd_backlight_breathe(uint8_t level, uint32_t period_ms);
+
+/*
+* Get the current brightness of the backlight, part way through any fade.
+*/
+uint8_t lcd_get_backlight_level(void);
+
+/*
+* Send any writes that the bus has queued up to the display.
+* Buses that don't queue writes ignore this.
+*/
+void lcd_flush(void);
+
 /*
 * Set the position of the cursor.
 * line: 0-based line number between 0 and LCD_SCREEN_MAX_HEIGHT - 1
@@ -165,9 +432,35 @@ void lcd_set_cursor_position(struct LCDSize size, struct LCDPosition position);
 * Use \x01 through \x08 inclusive to insert custom characters.
 * Use \n to move to the next line.
 * Automatic line wrapping is handled by this function.
+* In terminal mode, text is added to the bottom of the screen and scrolls up,
+* and the next line is only started once there is something to put on it.
 */
 void lcd_write(struct LCDSize size, const char *message);
 
+/*
+* Write characters to a single line of the display, starting at the given position.
+* Only characters that differ from what is already on the display are sent,
+* and the address is only set when skipping over unchanged characters.
+* Use \x01 through \x08 inclusive to insert custom characters.
+* Characters past the end of the line are ignored.
+* The cursor is left after the last character that was changed.
+*/
+void lcd_update(struct LCDSize size, struct LCDPosition position, const char *characters, uint8_t count);
+
+/*
+* Lay out a string inside a box on the screen, with its top left corner at the given position.
+* Lines are broken between words where possible, and words longer than the box are split.
+* Use \n to start a new line. Each line is aligned within the width of the box,
+* and every cell of the box not covered by text is cleared.
+* Text that doesn't fit in the box, and any part of the box off the screen, is cut off.
+* Only characters that differ from what is already on the display are sent, with lines sent
+* in order of DDRAM address so the address is set as few times as possible.
+* Use \x01 through \x08 inclusive to insert custom characters.
+* Returns false if not all of the text fit in the box.
+*/
+bool lcd_write_box(struct LCDSize size, struct LCDPosition position, struct LCDSize box,
+    enum LCDAlignment alignment, const char *message);
+
 /*
 * Define a custom character. Character number can be between 0 and 7.
 * Pixel array must contain 8 uint8_t values no greater than 0b11111 each.
@@ -175,3 +468,73 @@ void lcd_write(struct LCDSize size, const char *message);
 * of each row of the character, starting at the top.
 */
 void lcd_define_custom_char(uint8_t char_number, uint8_t pixels[const static 8]);
+
+// TERMINAL METHODS
+
+/*
+* Turn terminal mode on or off. In terminal mode, lcd_write adds text to a history of lines
+* that scrolls up the screen instead of wrapping back to the top.
+* Turning it on empties the history and the screen.
+*/
+void lcd_set_terminal_mode(struct LCDSize size, bool enabled);
+
+bool lcd_get_terminal_mode(void);
+
+/*
+* Move the screen back through the terminal mode history by a number of lines,
+* or forward towards the newest lines if negative. Stops at the oldest and newest lines.
+* While scrolled back, new text is added to the history without moving the screen.
+*/
+void lcd_terminal_scroll(struct LCDSize size, int lines);
+
+/*
+* Get the number of lines the screen is scrolled back through the terminal mode history,
+* and the most it can be scrolled back.
+*/
+uint8_t lcd_terminal_get_scrollback(void);
+uint8_t lcd_terminal_get_max_scrollback(struct LCDSize size);
+
+// HEALTH METHODS
+
+/*
+* Get the stored copy of the display state.
+*/
+const struct LCDState *lcd_get_state(void);
+
+/*
+* Fully initialise the display and return it to the given state.
+* Returns false if the display did not respond.
+*/
+bool lcd_restore_state(const struct LCDState *state);
+
+/*
+* Check that the display is still responding and still holds the expected contents,
+* re-initialising it and restoring its previous state if not.
+* Once a fault has been found, other methods only update the stored state until this restores the display.
+* Should be called periodically. Does nothing until the display has been initialised.
+*/
+void lcd_check_health(void);
+
+/*
+* Get counters for display faults and recoveries.
+*/
+struct LCDHealth lcd_get_health(void);
+
+/*
+* Get the times at which the display was first initialised and first written to.
+*/
+struct LCDStartupTiming lcd_get_startup_timing(void);
+
+// TRACING METHODS
+
+/*
+* Start recording when writes are sent to the bus, clearing any previous recording.
+*/
+void lcd_start_bus_trace(void);
+
+/*
+* Stop recording bus writes and get what was recorded since lcd_start_bus_trace.
+*/
+struct LCDBusTrace lcd_stop_bus_trace(void);
+
+#endif
@@ -0,0 +1,132 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "latency.h"
+
+static const char *const stage_names[LATENCY_STAGE_COUNT] = {
+    "received", "complete", "dispatched", "first write", "last write"
+};
+
+static bool enabled = false;
+static struct LatencyHistogram histograms[LATENCY_MAX_COMMAND_TYPES];
+static int histogram_count = 0;
+
+void latency_set_enabled(bool new_enabled) {
+    enabled = new_enabled;
+}
+
+bool latency_is_enabled(void) {
+    return enabled;
+}
+
+void latency_reset(void) {
+    histogram_count = 0;
+}
+
+static struct LatencyHistogram *_latency_get_histogram(const char *command) {
+    for (int i = 0; i < histogram_count; i++) {
+        if (strncmp(histograms[i].command, command, LATENCY_COMMAND_MAX_CHARS) == 0) {
+            return &histograms[i];
+        }
+    }
+
+    struct LatencyHistogram *histogram;
+    if (histogram_count < LATENCY_MAX_COMMAND_TYPES - 1) {
+        histogram = &histograms[histogram_count++];
+    } else if (histogram_count == LATENCY_MAX_COMMAND_TYPES - 1) {
+        // Keep the last histogram for everything that doesn't fit
+        histogram = &histograms[histogram_count++];
+        command = "other";
+    } else {
+        return &histograms[LATENCY_MAX_COMMAND_TYPES - 1];
+    }
+
+    memset(histogram, 0, sizeof(*histogram));
+    strncpy(histogram->command, command, LATENCY_COMMAND_MAX_CHARS);
+    return histogram;
+}
+
+/*
+* Get the time that the last stage which happened was reached,
+* or end_us if the command never wrote to the display.
+*/
+static uint64_t _latency_get_last_time(const uint64_t stage_times[LATENCY_STAGE_COUNT], uint64_t end_us) {
+    uint64_t last = stage_times[LATENCY_STAGE_LAST_BUS_WRITE];
+    return last != 0 ? last : end_us;
+}
+
+void latency_record(const char *command, const uint64_t stage_times[LATENCY_STAGE_COUNT], uint64_t end_us) {
+    struct LatencyHistogram *histogram = _latency_get_histogram(command);
+    histogram->count++;
+
+    for (int i = 0; i < LATENCY_STAGE_COUNT - 1; i++) {
+        if (stage_times[i] != 0 && stage_times[i + 1] != 0) {
+            histogram->stage_total_us[i] += stage_times[i + 1] - stage_times[i];
+            histogram->stage_count[i]++;
+        }
+    }
+
+    uint32_t total_us = (uint32_t)(
+        _latency_get_last_time(stage_times, end_us) - stage_times[LATENCY_STAGE_RECEIVED]);
+    if (total_us > histogram->max_us) {
+        histogram->max_us = total_us;
+    }
+
+    int bucket = 0;
+    uint32_t bucket_limit = LATENCY_FIRST_BUCKET_US;
+    while (bucket < LATENCY_BUCKET_COUNT - 1 && total_us >= bucket_limit) {
+        bucket++;
+        bucket_limit <<= 1;
+    }
+    histogram->buckets[bucket]++;
+}
+
+void latency_print_histograms(void) {
+    if (histogram_count == 0) {
+        printf("No latencies have been recorded.%s\n",
+            enabled ? "" : " Use #latency on to start recording.");
+        return;
+    }
+
+    for (int i = 0; i < histogram_count; i++) {
+        struct LatencyHistogram *histogram = &histograms[i];
+        printf("%s: %" PRIu32 " recorded, max %" PRIu32 "us\n    average:",
+            histogram->command, histogram->count, histogram->max_us);
+        for (int j = 0; j < LATENCY_STAGE_COUNT - 1; j++) {
+            // Commands that didn't write to the display have no times for the later stages
+            if (histogram->stage_count[j] != 0) {
+                printf(" %s>%s %" PRIu64 "us", stage_names[j], stage_names[j + 1],
+                    histogram->stage_total_us[j] / histogram->stage_count[j]);
+            }
+        }
+        printf("\n    total:");
+        uint32_t bucket_limit = LATENCY_FIRST_BUCKET_US;
+        for (int j = 0; j < LATENCY_BUCKET_COUNT; j++) {
+            if (histogram->buckets[j] != 0) {
+                if (j == LATENCY_BUCKET_COUNT - 1) {
+                    printf(" >=%" PRIu32 "us: %" PRIu32, bucket_limit >> 1, histogram->buckets[j]);
+                } else {
+                    printf(" <%" PRIu32 "us: %" PRIu32, bucket_limit, histogram->buckets[j]);
+                }
+            }
+            bucket_limit <<= 1;
+        }
+        putchar('\n');
+    }
+}
+
+void latency_print_trace(const char *tag, const uint64_t stage_times[LATENCY_STAGE_COUNT], uint64_t end_us) {
+    printf("@%s", tag);
+    for (int i = 0; i < LATENCY_STAGE_COUNT - 1; i++) {
+        if (stage_times[i] != 0 && stage_times[i + 1] != 0) {
+            printf(" %s>%s: %" PRIu64 "us", stage_names[i], stage_names[i + 1],
+                stage_times[i + 1] - stage_times[i]);
+        }
+    }
+    if (stage_times[LATENCY_STAGE_FIRST_BUS_WRITE] == 0) {
+        printf(" (no display writes)");
+    }
+    printf(" total: %" PRIu64 "us\n",
+        _latency_get_last_time(stage_times, end_us) - stage_times[LATENCY_STAGE_RECEIVED]);
+}
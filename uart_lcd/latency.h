@@ -0,0 +1,68 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Command types beyond this share a single "other" histogram
+#define LATENCY_MAX_COMMAND_TYPES 16
+#define LATENCY_COMMAND_MAX_CHARS 15
+
+// Bucket 0 holds latencies under LATENCY_FIRST_BUCKET_US, each bucket after that
+// holds latencies up to double the previous one, and the last holds everything longer
+#define LATENCY_BUCKET_COUNT 12
+#define LATENCY_FIRST_BUCKET_US 128
+
+enum LatencyStage {
+    // First byte of the line arrived over UART or USB, as reported by the stdio interrupt
+    LATENCY_STAGE_RECEIVED,
+    // End of line arrived
+    LATENCY_STAGE_LINE_COMPLETE,
+    // Line was split up and is about to be handled
+    LATENCY_STAGE_DISPATCHED,
+    LATENCY_STAGE_FIRST_BUS_WRITE,
+    LATENCY_STAGE_LAST_BUS_WRITE,
+    LATENCY_STAGE_COUNT
+};
+
+struct LatencyHistogram {
+    char command[LATENCY_COMMAND_MAX_CHARS + 1];
+    uint32_t count;
+    // Total time spent between each stage and the next, for working out averages
+    uint64_t stage_total_us[LATENCY_STAGE_COUNT - 1];
+    // Number of commands that reached both ends of each of those gaps
+    uint32_t stage_count[LATENCY_STAGE_COUNT - 1];
+    // Time from the first byte arriving to the last bus write (or the end of handling)
+    uint32_t buckets[LATENCY_BUCKET_COUNT];
+    uint32_t max_us;
+};
+
+/*
+* Turn recording of latency histograms on or off.
+*/
+void latency_set_enabled(bool enabled);
+bool latency_is_enabled(void);
+
+/*
+* Clear all recorded histograms.
+*/
+void latency_reset(void);
+
+/*
+* Add the time each stage happened at to the histogram for a command type.
+* Stages that didn't happen (i.e. commands that don't write to the display) should be 0.
+* end_us is when handling the command finished.
+*/
+void latency_record(const char *command, const uint64_t stage_times[LATENCY_STAGE_COUNT], uint64_t end_us);
+
+/*
+* Print every recorded histogram.
+*/
+void latency_print_histograms(void);
+
+/*
+* Print the time between each stage for a single command, prefixed with its tag.
+*/
+void latency_print_trace(const char *tag, const uint64_t stage_times[LATENCY_STAGE_COUNT], uint64_t end_us);
+
+#endif
@@ -1,14 +1,118 @@
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include "pico/stdlib.h"
 
+#include <flash_store.h>
 #include <lcd_controller.h>
 
+#include "latency.h"
+#include "pages.h"
+#include "templates.h"
+
 #define INPUT_BUFFER_SIZE 128
 #define MAX_ARGS 16
 
 #define PROMPT_STR "\n> "
 
+#define HEALTH_CHECK_INTERVAL_US 1000000
+
+// Settings are kept at the end of flash, well clear of the program
+#define SETTINGS_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_STORE_SIZE)
+#define SETTINGS_SLOT_SIZE 512
+
+// Must be incremented whenever the layout of SavedSettings or LCDState changes
+#define SETTINGS_VERSION 1
+
+struct SavedSettings {
+    uint32_t version;
+    struct LCDSize size;
+    // Includes the init mode, display flags, custom characters, and screen contents
+    struct LCDState display;
+};
+
+static const struct FlashStore settings_store = {
+    .offset = SETTINGS_FLASH_OFFSET,
+    .slot_size = SETTINGS_SLOT_SIZE
+};
+
+// When input was first seen waiting since there was last none, or 0.
+// Set from the stdio interrupt, so time spent in the UART FIFO or USB buffer is included in latencies.
+static volatile uint64_t input_waiting_since_us = 0;
+
+static void on_chars_available(void *param) {
+    (void)param;
+    if (input_waiting_since_us == 0) {
+        input_waiting_since_us = time_us_64();
+    }
+}
+
+/*
+* Get when the input about to be read arrived, or the current time if that isn't known.
+*/
+static uint64_t get_input_arrival_us(void) {
+    // 64-bit reads aren't atomic, so read again in case the interrupt set it part way through
+    uint64_t since;
+    do {
+        since = input_waiting_since_us;
+    } while (since != input_waiting_since_us);
+    return since != 0 ? since : time_us_64();
+}
+
+/*
+* Parse a decimal number between min and max inclusive.
+* Returns false if the string isn't a number or is out of range.
+*/
+static bool parse_number(const char *string, int min, int max, int *value) {
+    if (*string == '\0' || strlen(string) > 5) {
+        return false;
+    }
+    int result = 0;
+    for (const char *p = string; *p != '\0'; p++) {
+        if (*p < '0' || *p > '9') {
+            return false;
+        }
+        result = result * 10 + *p - '0';
+    }
+    if (result < min || result > max) {
+        return false;
+    }
+    *value = result;
+    return true;
+}
+
+/*
+* Parse an alignment given as (l)eft, (c)entre, or (r)ight.
+* Returns false if the string isn't one of those.
+*/
+static bool parse_alignment(const char *string, enum LCDAlignment *alignment) {
+    if (strcmp("l", string) == 0) {
+        *alignment = LCD_ALIGN_LEFT;
+    } else if (strcmp("c", string) == 0) {
+        *alignment = LCD_ALIGN_CENTRE;
+    } else if (strcmp("r", string) == 0) {
+        *alignment = LCD_ALIGN_RIGHT;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/*
+* Get the input line from argument first onwards, as it was typed.
+* The last argument holds the rest of the line unsplit, so no text is lost past MAX_ARGS.
+*/
+static char *join_arguments(int argc, char *argv[], int first) {
+    char *end = argv[argc - 1] + strlen(argv[argc - 1]);
+    for (char *p = argv[first]; p < end; p++) {
+        if (*p == '\0') {
+            // Splitting replaced a single space with a null terminator
+            *p = ' ';
+        }
+    }
+    return argv[first];
+}
+
 static void command_help(int argc, char *argv[], struct LCDSize *size) {
     if (argc != 0) {
         printf("The #help command takes no arguments.\n");
@@ -20,11 +124,15 @@ static void command_help(int argc, char *argv[], struct LCDSize *size) {
         "\nList of commands:\n"
         "    #set_size [1-%d] [1-%d] - Set the number of lines and columns the display has\n"
         "    #init 1/2 8/11 - Initialise the screen in (1)/(2) line mode with 5x(8) or 5x(11) font\n"
+        "        The screen is left off until turned on with #set\n"
         "    #set 0/1 0/1 0/1 - Set whether the display, cursor, and blinking are on (1) or off (0)\n"
         "    #clear - Clear the screen of all characters and return the cursor to the start position\n"
         "    #home - Return the cursor to the start position\n"
         "    #scroll c/s l/r - Scroll the (c)ursor/(s)creen (l)eft/(r)ight\n"
         "    #backlight 0/1 - Set the screen backlight on (1) or off (0)\n"
+        "    #brightness [0-100] [fade_ms] - Set the brightness of the backlight as a percentage,\n"
+        "        fading to it over [fade_ms] (up to %d) if given. With no arguments, get the brightness\n"
+        "    #brightness b [0-100] <period_ms> - Repeatedly fade the backlight up to a brightness and back down\n"
         "    #def_custom [0-7] <char> - Define a custom character at index 0-7\n"
         "        <char> is 8, 5-bit binary numbers separated by spaces\n"
         "    #write_custom [0-7] - Write the custom character at index 0-7\n"
@@ -32,11 +140,45 @@ static void command_help(int argc, char *argv[], struct LCDSize *size) {
         "    #newline - Move the cursor to the start of the next line\n"
         "    #setpos [1-%d] [0-%d] - Set the position of the cursor to a given line, at a 0-based offset\n"
         "    #getpos - Get the position of the cursor\n"
+        "    #box [1-%d] [0-%d] <lines> <columns> l/c/r [text] - Word wrap text into a box with its top left\n"
+        "        corner at a line and 0-based offset, aligned (l)eft, (c)entre, or (r)ight, clearing the rest of the box\n"
         "    #read - Read the text currently on the screen\n"
+        "    #terminal 0/1 - Turn terminal mode off (0) or on (1). In terminal mode each line of text\n"
+        "        is added to the bottom of the screen, scrolling older lines up into a history.\n"
+        "        Turning it on stops page rotation, and turning it off shows the page again\n"
+        "    #page [1-%d] - Show a page, keeping the text and cursor of the page it replaces.\n"
+        "        Text and other commands apply to the page being shown. With no arguments, get the page being shown\n"
+        "    #page_write [1-%d] <text> - Write text to a page, even if it isn't being shown\n"
+        "    #page_setpos [1-%d] [1-%d] [0-%d] - Set the position of the cursor of a page\n"
+        "    #page_clear [1-%d] - Remove all text from a page\n"
+        "    #page_rotate <seconds> [first] [last] - Show pages [first] to [last] (default all) in turn,\n"
+        "        moving to the next every <seconds> (1-999). 0 seconds stops rotating\n"
+        "    #scrollback [u/d/e] [lines] - Move (u)p or (d)own through the terminal history by [lines]\n"
+        "        (default one screen), or to the (e)nd. With no arguments, show the current position\n"
         "    #raw_tx 0/1 <data> - (ADVANCED) Transmit raw data to the LCD module, with RS pin on (1) or off (0)\n"
         "        <data> is an 8-bit binary number, going from D7-D0\n"
-        "    #raw_rx 0/1 - (ADVANCED) Receive raw data from the LCD module, with RS pin on (1) or off (0)\n",
-        LCD_SCREEN_MAX_HEIGHT, LCD_SCREEN_MAX_WIDTH, size->height, size->width - 1
+        "    #raw_rx 0/1 - (ADVANCED) Receive raw data from the LCD module, with RS pin on (1) or off (0)\n"
+        "    #health - Get the number of display faults and recoveries\n"
+        "    #save - Save the screen size, settings, custom characters, and text to be restored on power up\n"
+        "    #clear_save - Erase the saved settings so the display starts blank on power up\n"
+        "    #startup - Get how long after power up the display was initialised and first written to\n"
+        "    #latency [on/off/reset] - Record how long each command takes to reach the display, or show the results\n"
+        "        Prefix any line with #@<tag> to have its own timings printed after it is handled.\n"
+        "        A line is received when input is first waiting, so lines sent back to back\n"
+        "        can be received up to one line's transmission time early\n"
+        "    #tpl_new <name> - Create an empty screen template, replacing any with the same name\n"
+        "    #tpl_text <name> [1-%d] [0-%d] <text> - Set static text in a template at a line and 0-based offset\n"
+        "    #tpl_field <name> <field> [1-%d] [0-%d] <width> l/c/r [pad] - Add a named field to a template\n"
+        "        Values are aligned (l)eft, (c)entre, or (r)ight and filled with [pad] (default space)\n"
+        "    #tpl_show <name> - Draw a template on the screen, making it the one #f updates\n"
+        "    #tpl_list - List all templates and their fields\n"
+        "    #tpl_delete <name> - Delete a template\n"
+        "    #tpl_save - Save all templates to be restored on power up\n"
+        "    #f <field> [value] - Set the value of a field in the template on the screen\n",
+        LCD_SCREEN_MAX_HEIGHT, LCD_SCREEN_MAX_WIDTH, LCD_BACKLIGHT_MAX_FADE_MS, size->height, size->width - 1,
+        size->height, size->width - 1,
+        PAGE_COUNT, PAGE_COUNT, PAGE_COUNT, size->height, size->width - 1, PAGE_COUNT,
+        LCD_SCREEN_MAX_HEIGHT, LCD_SCREEN_MAX_WIDTH - 1, LCD_SCREEN_MAX_HEIGHT, LCD_SCREEN_MAX_WIDTH - 1
     );
 }
 
@@ -111,6 +253,7 @@ static void command_init(int argc, char *argv[]) {
     }
 
     lcd_initialise_display(lines, font);
+    template_clear_active();
 }
 
 static void command_set(int argc, char *argv[]) {
@@ -159,6 +302,7 @@ static void command_clear(int argc, char *argv[]) {
     }
 
     lcd_clear();
+    template_clear_active();
 }
 
 static void command_home(int argc, char *argv[]) {
@@ -197,6 +341,10 @@ static void command_scroll(int argc, char *argv[]) {
     }
 
     lcd_scroll(cursor_screen, left_right);
+    if (cursor_screen) {
+        // Fields are no longer where the template put them
+        template_clear_active();
+    }
 }
 
 static void command_backlight(int argc, char *argv[]) {
@@ -218,6 +366,49 @@ static void command_backlight(int argc, char *argv[]) {
     lcd_backlight(backlight);
 }
 
+static void command_brightness(int argc, char *argv[]) {
+    if (argc == 0) {
+        printf("brightness: %d%%\n",
+            (lcd_get_backlight_level() * 100 + LCD_BACKLIGHT_MAX_LEVEL / 2) / LCD_BACKLIGHT_MAX_LEVEL);
+        return;
+    }
+
+    bool breathe = strcmp("b", argv[0]) == 0;
+    if (breathe) {
+        // Remaining arguments are the same as for a fade
+        argc--;
+        argv++;
+        if (argc != 2) {
+            printf("The #brightness b command requires a brightness and a period.\n");
+            return;
+        }
+    } else if (argc > 2) {
+        printf("The #brightness command takes at most two arguments.\n");
+        return;
+    }
+
+    int percent;
+    if (!parse_number(argv[0], 0, 100, &percent)) {
+        printf("The brightness given to the #brightness command must be between 0 and 100.\n");
+        return;
+    }
+    int fade_ms = 0;
+    if (argc == 2 && !parse_number(argv[1], 0, LCD_BACKLIGHT_MAX_FADE_MS, &fade_ms)) {
+        printf("The time given to the #brightness command must be between 0 and %d milliseconds.\n",
+            LCD_BACKLIGHT_MAX_FADE_MS);
+        return;
+    }
+
+    uint8_t level = (percent * LCD_BACKLIGHT_MAX_LEVEL + 50) / 100;
+    if (!breathe) {
+        lcd_backlight_fade(level, fade_ms);
+    } else if (fade_ms == 0) {
+        printf("The period given to the #brightness b command can't be 0.\n");
+    } else if (!lcd_backlight_breathe(level, fade_ms)) {
+        printf("This display's backlight can only be turned on or off.\n");
+    }
+}
+
 static void command_def_custom(int argc, char *argv[]) {
     if (argc != 9) {
         printf("The #def_custom command requires nine arguments.\n");
@@ -282,6 +473,7 @@ static void command_write_custom(int argc, char *argv[], struct LCDSize *size) {
     char str_to_write[2] = {0};
     str_to_write[0] = character_index + 1;  // lcd_write uses 1-based indexing
     lcd_write(*size, str_to_write);
+    template_clear_active();
 }
 
 static void command_read_custom(int argc, char *argv[]) {
@@ -316,6 +508,10 @@ static void command_newline(int argc, char *argv[], struct LCDSize *size) {
     }
 
     lcd_write(*size, "\n");
+    if (lcd_get_terminal_mode()) {
+        // Starting a new line scrolls the screen
+        template_clear_active();
+    }
 }
 
 static void command_setpos(int argc, char *argv[], struct LCDSize *size) {
@@ -369,6 +565,47 @@ static void command_getpos(int argc, char *argv[], struct LCDSize *size) {
     printf("line: %d, offset: %d\n", position.line + 1, position.offset);
 }
 
+static void command_box(int argc, char *argv[], struct LCDSize *size) {
+    if (argc < 5) {
+        printf("The #box command requires at least five arguments.\n");
+        return;
+    }
+
+    int line;
+    if (!parse_number(argv[0], 1, size->height, &line)) {
+        printf("The first argument to the #box command must be between 1 and %d.\n", size->height);
+        return;
+    }
+    int offset;
+    if (!parse_number(argv[1], 0, size->width - 1, &offset)) {
+        printf("The second argument to the #box command must be between 0 and %d.\n", size->width - 1);
+        return;
+    }
+    int lines;
+    if (!parse_number(argv[2], 1, size->height, &lines)) {
+        printf("The third argument to the #box command must be between 1 and %d.\n", size->height);
+        return;
+    }
+    int columns;
+    if (!parse_number(argv[3], 1, size->width, &columns)) {
+        printf("The fourth argument to the #box command must be between 1 and %d.\n", size->width);
+        return;
+    }
+
+    enum LCDAlignment alignment;
+    if (!parse_alignment(argv[4], &alignment)) {
+        printf("The fifth argument to the #box command must be l, c, or r.\n");
+        return;
+    }
+
+    const char *text = argc > 5 ? join_arguments(argc, argv, 5) : "";
+    if (!lcd_write_box(*size, (struct LCDPosition){.line = line - 1, .offset = offset},
+            (struct LCDSize){.width = columns, .height = lines}, alignment, text)) {
+        printf("Not all of the text fit in the box.\n");
+    }
+    template_clear_active();
+}
+
 static void command_read(int argc, char *argv[], struct LCDSize *size) {
     if (argc != 0) {
         printf("The #read command takes no arguments.\n");
@@ -388,6 +625,182 @@ static void command_read(int argc, char *argv[], struct LCDSize *size) {
     putchar('\n');
 }
 
+static bool parse_page(const char *command, const char *argument, uint8_t *index) {
+    int page;
+    if (!parse_number(argument, 1, PAGE_COUNT, &page)) {
+        printf("The first argument to the %s command must be a page between 1 and %d.\n", command, PAGE_COUNT);
+        return false;
+    }
+    if (lcd_get_terminal_mode()) {
+        printf("Pages can't be used in terminal mode.\n");
+        return false;
+    }
+    // Convert to 0-indexed
+    *index = page - 1;
+    return true;
+}
+
+static void command_page(int argc, char *argv[], struct LCDSize *size) {
+    if (argc == 0) {
+        printf("page: %d\n", page_get_visible() + 1);
+        return;
+    }
+    if (argc != 1) {
+        printf("The #page command takes at most one argument.\n");
+        return;
+    }
+
+    uint8_t index;
+    if (parse_page("#page", argv[0], &index) && index != page_get_visible()) {
+        page_show(*size, index);
+        template_clear_active();
+    }
+}
+
+static void command_page_write(int argc, char *argv[], struct LCDSize *size) {
+    if (argc < 2) {
+        printf("The #page_write command requires at least two arguments.\n");
+        return;
+    }
+
+    uint8_t index;
+    if (parse_page("#page_write", argv[0], &index)) {
+        page_write(*size, index, join_arguments(argc, argv, 1));
+        if (index == page_get_visible()) {
+            template_clear_active();
+        }
+    }
+}
+
+static void command_page_setpos(int argc, char *argv[], struct LCDSize *size) {
+    if (argc != 3) {
+        printf("The #page_setpos command requires three arguments.\n");
+        return;
+    }
+
+    uint8_t index;
+    if (!parse_page("#page_setpos", argv[0], &index)) {
+        return;
+    }
+    int line;
+    if (!parse_number(argv[1], 1, size->height, &line)) {
+        printf("The second argument to the #page_setpos command must be between 1 and %d.\n", size->height);
+        return;
+    }
+    int offset;
+    if (!parse_number(argv[2], 0, size->width - 1, &offset)) {
+        printf("The third argument to the #page_setpos command must be between 0 and %d.\n", size->width - 1);
+        return;
+    }
+
+    page_set_cursor_position(*size, index,
+        (struct LCDPosition){.line = line - 1, .offset = offset});
+}
+
+static void command_page_clear(int argc, char *argv[]) {
+    if (argc != 1) {
+        printf("The #page_clear command requires one argument.\n");
+        return;
+    }
+
+    uint8_t index;
+    if (parse_page("#page_clear", argv[0], &index)) {
+        page_clear(index);
+        if (index == page_get_visible()) {
+            template_clear_active();
+        }
+    }
+}
+
+static void command_page_rotate(int argc, char *argv[]) {
+    if (argc != 1 && argc != 3) {
+        printf("The #page_rotate command requires either one or three arguments.\n");
+        return;
+    }
+
+    int seconds;
+    if (!parse_number(argv[0], 0, 999, &seconds)) {
+        printf("The first argument to the #page_rotate command must be between 0 and 999.\n");
+        return;
+    }
+
+    int first = 1;
+    int last = PAGE_COUNT;
+    if (argc == 3 && (!parse_number(argv[1], 1, PAGE_COUNT, &first)
+            || !parse_number(argv[2], first, PAGE_COUNT, &last))) {
+        printf("The pages given to the #page_rotate command must be between 1 and %d, first then last.\n",
+            PAGE_COUNT);
+        return;
+    }
+    if (seconds != 0 && lcd_get_terminal_mode()) {
+        printf("Pages can't be used in terminal mode.\n");
+        return;
+    }
+
+    page_set_rotation((uint32_t)seconds * 1000, first - 1, last - 1);
+}
+
+static void command_terminal(int argc, char *argv[], struct LCDSize *size) {
+    if (argc != 1) {
+        printf("The #terminal command requires one argument.\n");
+        return;
+    }
+
+    bool terminal;
+    if (strcmp("0", argv[0]) == 0) {
+        terminal = false;
+    } else if (strcmp("1", argv[0]) == 0) {
+        terminal = true;
+    } else {
+        printf("The first argument to the #terminal command must be 0 or 1.\n");
+        return;
+    }
+
+    bool was_terminal = lcd_get_terminal_mode();
+    if (terminal && !was_terminal) {
+        // The terminal takes over the display, so keep the page that was on it
+        page_suspend(*size);
+    }
+    lcd_set_terminal_mode(*size, terminal);
+    if (!terminal && was_terminal) {
+        page_resume(*size);
+    }
+    template_clear_active();
+}
+
+static void command_scrollback(int argc, char *argv[], struct LCDSize *size) {
+    if (!lcd_get_terminal_mode()) {
+        printf("The #scrollback command can only be used in terminal mode.\n");
+        return;
+    }
+    if (argc == 0) {
+        printf("scrolled back: %d of %d lines\n",
+            lcd_terminal_get_scrollback(), lcd_terminal_get_max_scrollback(*size));
+        return;
+    }
+    if (argc > 2) {
+        printf("The #scrollback command takes at most two arguments.\n");
+        return;
+    }
+
+    int lines = size->height;
+    if (argc == 2 && !parse_number(argv[1], 1, LCD_TERMINAL_HISTORY_LINES, &lines)) {
+        printf("The second argument to the #scrollback command must be between 1 and %d.\n",
+            LCD_TERMINAL_HISTORY_LINES);
+        return;
+    }
+
+    if (strcmp("u", argv[0]) == 0) {
+        lcd_terminal_scroll(*size, lines);
+    } else if (strcmp("d", argv[0]) == 0) {
+        lcd_terminal_scroll(*size, -lines);
+    } else if (strcmp("e", argv[0]) == 0 && argc == 1) {
+        lcd_terminal_scroll(*size, -LCD_TERMINAL_HISTORY_LINES);
+    } else {
+        printf("The first argument to the #scrollback command must be u, d, or e (which takes no line count).\n");
+    }
+}
+
 static void command_raw_tx(int argc, char *argv[]) {
     if (argc != 2) {
         printf("The #raw_tx command requires two arguments.\n");
@@ -422,6 +835,8 @@ static void command_raw_tx(int argc, char *argv[]) {
     }
 
     lcd_transmit_data(rs_pin, data);
+    // There's no telling what the display is showing now
+    template_clear_active();
 }
 
 static void command_raw_rx(int argc, char *argv[]) {
@@ -444,24 +859,345 @@ static void command_raw_rx(int argc, char *argv[]) {
     printf("%08b (0x%02x) (%d)\n", data, data, data);
 }
 
+static void command_health(int argc, char *argv[]) {
+    if (argc != 0) {
+        printf("The #health command takes no arguments.\n");
+        return;
+    }
+
+    struct LCDHealth health = lcd_get_health();
+    printf("busy timeouts: %" PRIu32 ", bus errors: %" PRIu32 ", faults detected: %" PRIu32
+        ", recoveries: %" PRIu32 ", failed recoveries: %" PRIu32 "\n"
+        "last recovery time: %" PRIu32 "us, max recovery time: %" PRIu32 "us\n",
+        health.busy_timeouts, health.bus_errors, health.faults_detected, health.recoveries, health.failed_recoveries,
+        health.last_recovery_us, health.max_recovery_us
+    );
+}
+
+static void command_startup(int argc, char *argv[]) {
+    if (argc != 0) {
+        printf("The #startup command takes no arguments.\n");
+        return;
+    }
+
+    struct LCDStartupTiming timing = lcd_get_startup_timing();
+    if (timing.init_done_us == 0) {
+        printf("The display has not been initialised.\n");
+        return;
+    }
+    printf("initialisation started: %" PRIu64 "us, finished: %" PRIu64 "us (took %" PRIu64 "us)\n",
+        timing.init_start_us, timing.init_done_us, timing.init_done_us - timing.init_start_us);
+    if (timing.first_write_us == 0) {
+        printf("first write: none yet\n");
+    } else {
+        printf("first write: %" PRIu64 "us\n", timing.first_write_us);
+    }
+}
+
+static void command_latency(int argc, char *argv[]) {
+    if (argc == 0) {
+        latency_print_histograms();
+        return;
+    }
+    if (argc != 1) {
+        printf("The #latency command takes at most 1 argument.\n");
+        return;
+    }
+
+    if (strcmp(argv[0], "on") == 0) {
+        latency_set_enabled(true);
+    } else if (strcmp(argv[0], "off") == 0) {
+        latency_set_enabled(false);
+    } else if (strcmp(argv[0], "reset") == 0) {
+        latency_reset();
+    } else {
+        printf("The argument to #latency must be on, off, or reset.\n");
+    }
+}
+
+static void command_save(int argc, char *argv[], struct LCDSize *size) {
+    if (argc != 0) {
+        printf("The #save command takes no arguments.\n");
+        return;
+    }
+
+    struct SavedSettings settings = {
+        .version = SETTINGS_VERSION,
+        .size = *size,
+        .display = *lcd_get_state()
+    };
+    if (!flash_store_save(&settings_store, &settings, sizeof(settings))) {
+        printf("The settings could not be saved.\n");
+        return;
+    }
+    if (!settings.display.initialised) {
+        printf("The display has not been initialised, so only the screen size was saved.\n");
+    }
+}
+
+static void command_clear_save(int argc, char *argv[]) {
+    if (argc != 0) {
+        printf("The #clear_save command takes no arguments.\n");
+        return;
+    }
+
+    flash_store_erase(&settings_store);
+}
+
+static void command_tpl_new(int argc, char *argv[]) {
+    if (argc != 1) {
+        printf("The #tpl_new command requires one argument.\n");
+        return;
+    }
+
+    if (template_create(argv[0]) == NULL) {
+        printf("Template names can be at most %d characters long, and there can be at most %d templates.\n",
+            TEMPLATE_NAME_MAX_CHARS, TEMPLATE_MAX_COUNT);
+    }
+}
+
+static void command_tpl_text(int argc, char *argv[]) {
+    if (argc < 4) {
+        printf("The #tpl_text command requires at least four arguments.\n");
+        return;
+    }
+
+    struct Template *template = template_find(argv[0]);
+    if (template == NULL) {
+        printf("There is no template named \"%s\".\n", argv[0]);
+        return;
+    }
+
+    int line;
+    if (!parse_number(argv[1], 1, LCD_SCREEN_MAX_HEIGHT, &line)) {
+        printf("The second argument to the #tpl_text command must be between 1 and %d.\n", LCD_SCREEN_MAX_HEIGHT);
+        return;
+    }
+    int offset;
+    if (!parse_number(argv[2], 0, LCD_SCREEN_MAX_WIDTH - 1, &offset)) {
+        printf("The third argument to the #tpl_text command must be between 0 and %d.\n", LCD_SCREEN_MAX_WIDTH - 1);
+        return;
+    }
+
+    template_set_text(template,
+        (struct LCDPosition){.line = line - 1, .offset = offset}, join_arguments(argc, argv, 3));
+}
+
+static void command_tpl_field(int argc, char *argv[]) {
+    if (argc != 6 && argc != 7) {
+        printf("The #tpl_field command requires six or seven arguments.\n");
+        return;
+    }
+
+    struct Template *template = template_find(argv[0]);
+    if (template == NULL) {
+        printf("There is no template named \"%s\".\n", argv[0]);
+        return;
+    }
+
+    int line;
+    if (!parse_number(argv[2], 1, LCD_SCREEN_MAX_HEIGHT, &line)) {
+        printf("The third argument to the #tpl_field command must be between 1 and %d.\n", LCD_SCREEN_MAX_HEIGHT);
+        return;
+    }
+    int offset;
+    if (!parse_number(argv[3], 0, LCD_SCREEN_MAX_WIDTH - 1, &offset)) {
+        printf("The fourth argument to the #tpl_field command must be between 0 and %d.\n", LCD_SCREEN_MAX_WIDTH - 1);
+        return;
+    }
+    int width;
+    if (!parse_number(argv[4], 1, LCD_SCREEN_MAX_WIDTH - offset, &width)) {
+        printf("The fifth argument to the #tpl_field command must be between 1 and %d.\n", LCD_SCREEN_MAX_WIDTH - offset);
+        return;
+    }
+
+    enum LCDAlignment alignment;
+    if (!parse_alignment(argv[5], &alignment)) {
+        printf("The sixth argument to the #tpl_field command must be l, c, or r.\n");
+        return;
+    }
+
+    char padding = ' ';
+    if (argc == 7) {
+        if (strlen(argv[6]) != 1) {
+            printf("The seventh argument to the #tpl_field command must be a single character.\n");
+            return;
+        }
+        padding = argv[6][0];
+    }
+
+    if (!template_set_field(template, argv[1],
+            (struct LCDPosition){.line = line - 1, .offset = offset}, width, alignment, padding)) {
+        printf("Field names can be at most %d characters long, and templates can have at most %d fields.\n",
+            TEMPLATE_NAME_MAX_CHARS, TEMPLATE_MAX_FIELDS);
+    }
+}
+
+static void command_tpl_show(int argc, char *argv[], struct LCDSize *size) {
+    if (argc != 1) {
+        printf("The #tpl_show command requires one argument.\n");
+        return;
+    }
+
+    struct Template *template = template_find(argv[0]);
+    if (template == NULL) {
+        printf("There is no template named \"%s\".\n", argv[0]);
+        return;
+    }
+    if (lcd_get_terminal_mode()) {
+        printf("Templates can't be shown in terminal mode.\n");
+        return;
+    }
+
+    template_show(*size, template);
+}
+
+static void command_tpl_list(int argc, char *argv[]) {
+    if (argc != 0) {
+        printf("The #tpl_list command takes no arguments.\n");
+        return;
+    }
+
+    const struct Template *active = template_get_active();
+    for (int i = 0; i < template_count(); i++) {
+        const struct Template *template = template_get(i);
+        printf("%s%s:", template->name, template == active ? " (shown)" : "");
+        for (int j = 0; j < template->field_count; j++) {
+            const struct TemplateField *field = &template->fields[j];
+            printf(" %s (line: %d, offset: %d, width: %d)", field->name,
+                field->position.line + 1, field->position.offset, field->width);
+        }
+        putchar('\n');
+    }
+}
+
+static void command_tpl_delete(int argc, char *argv[]) {
+    if (argc != 1) {
+        printf("The #tpl_delete command requires one argument.\n");
+        return;
+    }
+
+    if (!template_delete(argv[0])) {
+        printf("There is no template named \"%s\".\n", argv[0]);
+    }
+}
+
+static void command_tpl_save(int argc, char *argv[]) {
+    if (argc != 0) {
+        printf("The #tpl_save command takes no arguments.\n");
+        return;
+    }
+
+    if (!templates_save()) {
+        printf("The templates could not be saved.\n");
+    }
+}
+
+static void command_f(int argc, char *argv[], struct LCDSize *size) {
+    if (argc < 1) {
+        printf("The #f command requires at least one argument.\n");
+        return;
+    }
+
+    if (template_get_active() == NULL) {
+        printf("No template is being shown. Use #tpl_show to show one.\n");
+        return;
+    }
+
+    const char *value = argc > 1 ? join_arguments(argc, argv, 1) : "";
+    if (!template_update_field(*size, argv[0], value)) {
+        printf("The template being shown has no field named \"%s\".\n", argv[0]);
+    }
+}
+
 int main() {
     stdio_init_all();
 
-    lcd_init_gpio();
+    // Bus is chosen with the UART_LCD_BUS CMake option
+#if defined(UART_LCD_BUS_PCF8574)
+    lcd_init_pcf8574(LCD_PCF8574_DEFAULT_ADDRESS);
+#elif defined(UART_LCD_BUS_74HC595)
+    lcd_init_74hc595();
+#elif defined(UART_LCD_BUS_GPIO4)
+    lcd_init_gpio(LCD_INTERFACE_4BIT);
+#else
+    lcd_init_gpio(LCD_INTERFACE_8BIT);
+#endif
+
+    struct LCDSize lcd_size = (struct LCDSize){.width = 16, .height = 2};
+
+    templates_load();
+
+    // Restore the saved display before anything else, so it is ready as soon as possible
+    struct SavedSettings settings;
+    if (flash_store_load(&settings_store, &settings, sizeof(settings))
+            && settings.version == SETTINGS_VERSION) {
+        lcd_size = settings.size;
+        if (settings.display.initialised) {
+            lcd_restore_state(&settings.display);
+        }
+    }
+
+    // The active template may not match the restored screen, so draw it again if there's a display to draw on
+    const struct Template *active_template = template_get_active();
+    if (active_template != NULL) {
+        if (lcd_get_state()->initialised) {
+            template_show(lcd_size, active_template);
+            lcd_flush();
+        } else {
+            template_clear_active();
+        }
+    }
 
     printf("LCD <-> UART Controller. Commands start with #, i.e. \"#help\"\n");
 
     char input_buffer[INPUT_BUFFER_SIZE] = {0};
     char *buffer_end = input_buffer + INPUT_BUFFER_SIZE - 1;
 
-    struct LCDSize lcd_size = (struct LCDSize){.width = 16, .height = 2};
+    uint64_t next_health_check = time_us_64() + HEALTH_CHECK_INTERVAL_US;
+    stdio_set_chars_available_callback(on_chars_available, NULL);
 
     while (true) {
         printf(PROMPT_STR);
 
+        uint64_t stage_times[LATENCY_STAGE_COUNT] = {0};
+
         char *buffer_ptr = input_buffer;
         while (true) {
-            char c = getchar();
+            // Check on the display whenever it has been idle for long enough,
+            // so a hung display doesn't go unnoticed until the next command.
+            // Rotating pages are switched between characters, never in the middle of a command.
+            uint64_t now = time_us_64();
+            uint64_t next_event = next_health_check;
+            uint64_t next_rotation = page_get_next_rotation_us();
+            if (next_rotation != 0 && next_rotation < next_event) {
+                next_event = next_rotation;
+            }
+            int input = getchar_timeout_us(0);
+            if (input == PICO_ERROR_TIMEOUT) {
+                // Nothing is waiting, so whatever arrives next is timed from when it arrives
+                input_waiting_since_us = 0;
+                input = now < next_event
+                    ? getchar_timeout_us((uint32_t)(next_event - now))
+                    : PICO_ERROR_TIMEOUT;
+            }
+            if (input == PICO_ERROR_TIMEOUT) {
+                if (next_rotation != 0 && time_us_64() >= next_rotation) {
+                    if (page_rotate_if_due(lcd_size)) {
+                        template_clear_active();
+                    }
+                    lcd_flush();
+                }
+                if (time_us_64() >= next_health_check) {
+                    lcd_check_health();
+                    next_health_check = time_us_64() + HEALTH_CHECK_INTERVAL_US;
+                }
+                continue;
+            }
+            char c = (char)input;
+            if (stage_times[LATENCY_STAGE_RECEIVED] == 0) {
+                stage_times[LATENCY_STAGE_RECEIVED] = get_input_arrival_us();
+            }
 
             if (c == '\x7f' || c == '\b') {
                 // '\x7f' is ASCII delete - user pressed backspace key.
@@ -487,22 +1223,52 @@ int main() {
         }
         // Null terminate the input string
         *buffer_ptr = '\0';
+        stage_times[LATENCY_STAGE_LINE_COMPLETE] = time_us_64();
+
+        // A line starting with #@<tag> has its own timings printed once it has been handled
+        char *line = input_buffer;
+        char *tag = NULL;
+        if (line[0] == '#' && line[1] == '@') {
+            tag = line + 2;
+            line = strchr(line, ' ');
+            if (line == NULL) {
+                line = buffer_ptr;
+            } else {
+                *line++ = '\0';
+            }
+        }
 
-        if (strnlen(input_buffer, INPUT_BUFFER_SIZE) == 0) {
+        if (strnlen(line, INPUT_BUFFER_SIZE) == 0) {
             printf("You must enter either a command or text to write to the screen.\n");
             continue;
         }
         
-        if (input_buffer[0] == '#') {
+        bool tracing = tag != NULL || latency_is_enabled();
+        const char *command_type = "text";
+
+        if (line[0] == '#') {
             // Command
             // Split command into individual components
-            char *command = strtok(input_buffer, " ");
+            char *command = strtok(line, " ");
             char *argv[MAX_ARGS];
             int argc = 0;
             char *arg = command;
-            while (argc < MAX_ARGS && (arg = strtok(NULL, " ")) != NULL) {
+            while (argc < MAX_ARGS - 1 && (arg = strtok(NULL, " ")) != NULL) {
                 argv[argc++] = arg;
             }
+            // The last argument is everything left on the line, so long text isn't cut short
+            if (argc == MAX_ARGS - 1 && (arg = strtok(NULL, "")) != NULL) {
+                arg += strspn(arg, " ");
+                if (*arg != '\0') {
+                    argv[argc++] = arg;
+                }
+            }
+
+            command_type = command;
+            stage_times[LATENCY_STAGE_DISPATCHED] = time_us_64();
+            if (tracing) {
+                lcd_start_bus_trace();
+            }
 
             if (strcmp(command, "#help") == 0) {
                 command_help(argc, argv, &lcd_size);
@@ -520,6 +1286,8 @@ int main() {
                 command_scroll(argc, argv);
             } else if (strcmp(command, "#backlight") == 0) {
                 command_backlight(argc, argv);
+            } else if (strcmp(command, "#brightness") == 0) {
+                command_brightness(argc, argv);
             } else if (strcmp(command, "#def_custom") == 0) {
                 command_def_custom(argc, argv);
             } else if (strcmp(command, "#write_custom") == 0) {
@@ -532,18 +1300,85 @@ int main() {
                 command_setpos(argc, argv, &lcd_size);
             } else if (strcmp(command, "#getpos") == 0) {
                 command_getpos(argc, argv, &lcd_size);
+            } else if (strcmp(command, "#box") == 0) {
+                command_box(argc, argv, &lcd_size);
             } else if (strcmp(command, "#read") == 0) {
                 command_read(argc, argv, &lcd_size);
+            } else if (strcmp(command, "#page") == 0) {
+                command_page(argc, argv, &lcd_size);
+            } else if (strcmp(command, "#page_write") == 0) {
+                command_page_write(argc, argv, &lcd_size);
+            } else if (strcmp(command, "#page_setpos") == 0) {
+                command_page_setpos(argc, argv, &lcd_size);
+            } else if (strcmp(command, "#page_clear") == 0) {
+                command_page_clear(argc, argv);
+            } else if (strcmp(command, "#page_rotate") == 0) {
+                command_page_rotate(argc, argv);
+            } else if (strcmp(command, "#terminal") == 0) {
+                command_terminal(argc, argv, &lcd_size);
+            } else if (strcmp(command, "#scrollback") == 0) {
+                command_scrollback(argc, argv, &lcd_size);
             } else if (strcmp(command, "#raw_tx") == 0) {
                 command_raw_tx(argc, argv);
             } else if (strcmp(command, "#raw_rx") == 0) {
                 command_raw_rx(argc, argv);
+            } else if (strcmp(command, "#health") == 0) {
+                command_health(argc, argv);
+            } else if (strcmp(command, "#startup") == 0) {
+                command_startup(argc, argv);
+            } else if (strcmp(command, "#latency") == 0) {
+                command_latency(argc, argv);
+            } else if (strcmp(command, "#f") == 0) {
+                command_f(argc, argv, &lcd_size);
+            } else if (strcmp(command, "#tpl_new") == 0) {
+                command_tpl_new(argc, argv);
+            } else if (strcmp(command, "#tpl_text") == 0) {
+                command_tpl_text(argc, argv);
+            } else if (strcmp(command, "#tpl_field") == 0) {
+                command_tpl_field(argc, argv);
+            } else if (strcmp(command, "#tpl_show") == 0) {
+                command_tpl_show(argc, argv, &lcd_size);
+            } else if (strcmp(command, "#tpl_list") == 0) {
+                command_tpl_list(argc, argv);
+            } else if (strcmp(command, "#tpl_delete") == 0) {
+                command_tpl_delete(argc, argv);
+            } else if (strcmp(command, "#tpl_save") == 0) {
+                command_tpl_save(argc, argv);
+            } else if (strcmp(command, "#save") == 0) {
+                command_save(argc, argv, &lcd_size);
+            } else if (strcmp(command, "#clear_save") == 0) {
+                command_clear_save(argc, argv);
             } else {
                 printf("\"%s\" is not a recognised command. Run #help to see all available commands.\n", command);
             }
         } else {
             // Text
-            lcd_write(lcd_size, input_buffer);
+            stage_times[LATENCY_STAGE_DISPATCHED] = time_us_64();
+            if (tracing) {
+                lcd_start_bus_trace();
+            }
+            lcd_write(lcd_size, line);
+            template_clear_active();
+            if (lcd_get_terminal_mode()) {
+                // Each line of text is its own line in terminal mode
+                lcd_write(lcd_size, "\n");
+            }
+        }
+
+        // Make sure everything reaches the display on buses that queue writes
+        lcd_flush();
+
+        if (tracing) {
+            struct LCDBusTrace trace = lcd_stop_bus_trace();
+            stage_times[LATENCY_STAGE_FIRST_BUS_WRITE] = trace.first_write_us;
+            stage_times[LATENCY_STAGE_LAST_BUS_WRITE] = trace.last_write_us;
+            uint64_t end_us = time_us_64();
+            if (latency_is_enabled()) {
+                latency_record(command_type, stage_times, end_us);
+            }
+            if (tag != NULL) {
+                latency_print_trace(tag, stage_times, end_us);
+            }
         }
     }
 }
@@ -0,0 +1,145 @@
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include "pages.h"
+
+struct PageRotation {
+    uint32_t period_ms;
+    uint8_t first;
+    uint8_t last;
+    uint64_t next_us;
+};
+
+static struct Page pages[PAGE_COUNT];
+static bool pages_initialised = false;
+static uint8_t visible = 0;
+static struct PageRotation rotation = {0};
+
+static void _pages_initialise(void) {
+    if (pages_initialised) {
+        return;
+    }
+    for (int i = 0; i < PAGE_COUNT; i++) {
+        memset(pages[i].text, ' ', sizeof(pages[i].text));
+    }
+    pages_initialised = true;
+}
+
+uint8_t page_get_visible(void) {
+    return visible;
+}
+
+/*
+* Copy the text and cursor of the page being shown from the stored display state,
+* without reading anything back from the display.
+*/
+static void _page_keep_visible(struct LCDSize size) {
+    struct Page *page = &pages[visible];
+    char string[LCD_STRING_MAX_CHARS];
+    lcd_read_stored(size, string, &page->cursor);
+    for (int y = 0; y < size.height; y++) {
+        memcpy(page->text[y], &string[y * (size.width + 1)], size.width);
+    }
+}
+
+/*
+* Draw a page over whatever is on the display. lcd_update only sends the characters that differ.
+*/
+static void _page_draw(struct LCDSize size, uint8_t index) {
+    struct Page *page = &pages[index];
+    for (int y = 0; y < size.height; y++) {
+        lcd_update(size, (struct LCDPosition){.line = y, .offset = 0}, page->text[y], size.width);
+    }
+    lcd_set_cursor_position(size, page->cursor);
+}
+
+void page_show(struct LCDSize size, uint8_t index) {
+    _pages_initialise();
+    if (index == visible) {
+        return;
+    }
+
+    _page_keep_visible(size);
+    _page_draw(size, index);
+    visible = index;
+}
+
+void page_suspend(struct LCDSize size) {
+    _pages_initialise();
+    _page_keep_visible(size);
+    page_set_rotation(0, 0, 0);
+}
+
+void page_resume(struct LCDSize size) {
+    _pages_initialise();
+    _page_draw(size, visible);
+}
+
+void page_write(struct LCDSize size, uint8_t index, const char *message) {
+    _pages_initialise();
+    if (index == visible) {
+        lcd_write(size, message);
+        return;
+    }
+
+    // Wraps onto the next line, and from the last line to the first, like lcd_write
+    struct Page *page = &pages[index];
+    for (const char *p = message; *p != 0; p++) {
+        if (*p != '\n') {
+            page->text[page->cursor.line][page->cursor.offset++] = *p;
+        }
+        if (*p == '\n' || page->cursor.offset >= size.width) {
+            page->cursor.line = (page->cursor.line + 1) % size.height;
+            page->cursor.offset = 0;
+        }
+    }
+}
+
+void page_set_cursor_position(struct LCDSize size, uint8_t index, struct LCDPosition position) {
+    _pages_initialise();
+    if (index == visible) {
+        lcd_set_cursor_position(size, position);
+    } else {
+        pages[index].cursor = position;
+    }
+}
+
+void page_clear(uint8_t index) {
+    _pages_initialise();
+    if (index == visible) {
+        lcd_clear();
+    }
+    memset(pages[index].text, ' ', sizeof(pages[index].text));
+    pages[index].cursor = (struct LCDPosition){.line = 0, .offset = 0};
+}
+
+void page_set_rotation(uint32_t period_ms, uint8_t first, uint8_t last) {
+    rotation.period_ms = period_ms;
+    rotation.first = first;
+    rotation.last = last;
+    rotation.next_us = period_ms == 0 ? 0 : time_us_64() + (uint64_t)period_ms * 1000;
+}
+
+uint64_t page_get_next_rotation_us(void) {
+    return rotation.next_us;
+}
+
+bool page_rotate_if_due(struct LCDSize size) {
+    if (rotation.period_ms == 0 || time_us_64() < rotation.next_us) {
+        return false;
+    }
+
+    uint8_t next = visible + 1;
+    if (visible < rotation.first || next > rotation.last) {
+        next = rotation.first;
+    }
+    bool changed = next != visible;
+    page_show(size, next);
+
+    // Keep to the same schedule even if this was late, unless it has fallen a whole period behind
+    rotation.next_us += (uint64_t)rotation.period_ms * 1000;
+    if (rotation.next_us <= time_us_64()) {
+        rotation.next_us = time_us_64() + (uint64_t)rotation.period_ms * 1000;
+    }
+    return changed;
+}
@@ -0,0 +1,78 @@
+#ifndef PAGES_H
+#define PAGES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <lcd_controller.h>
+
+#define PAGE_COUNT 8
+
+/*
+* A screen of text kept in RAM, with its own cursor.
+* The page being shown has its text and cursor kept on the display instead,
+* and is only copied back here (from the stored display state) when another page is shown
+* or the pages are suspended.
+*/
+struct Page {
+    // Custom characters are represented by \x01 through \x08 inclusive
+    char text[LCD_SCREEN_MAX_HEIGHT][LCD_SCREEN_MAX_WIDTH];
+    struct LCDPosition cursor;
+};
+
+/*
+* Get the 0-based index of the page being shown.
+*/
+uint8_t page_get_visible(void);
+
+/*
+* Show a page on the display, keeping the text and cursor of the page it replaces.
+* Only characters that differ between the two pages are sent.
+*/
+void page_show(struct LCDSize size, uint8_t index);
+
+/*
+* Copy the page being shown into RAM and stop rotating pages,
+* before something else (such as terminal mode) takes over the display.
+*/
+void page_suspend(struct LCDSize size);
+
+/*
+* Draw the page being shown again after page_suspend, once the display is free.
+*/
+void page_resume(struct LCDSize size);
+
+/*
+* Write a string to a page starting at its cursor, the same way lcd_write does.
+* Writing to the page being shown writes straight to the display.
+*/
+void page_write(struct LCDSize size, uint8_t index, const char *message);
+
+/*
+* Set the position of the cursor of a page.
+*/
+void page_set_cursor_position(struct LCDSize size, uint8_t index, struct LCDPosition position);
+
+/*
+* Remove all characters from a page and return its cursor to the start.
+*/
+void page_clear(uint8_t index);
+
+/*
+* Show pages first to last in turn, moving to the next every period_ms milliseconds.
+* A period of 0 stops rotating.
+*/
+void page_set_rotation(uint32_t period_ms, uint8_t first, uint8_t last);
+
+/*
+* Get the time since boot that the next page should be shown, or 0 if pages aren't rotating.
+*/
+uint64_t page_get_next_rotation_us(void);
+
+/*
+* Show the next page if it is time to.
+* Returns true if a different page was shown.
+*/
+bool page_rotate_if_due(struct LCDSize size);
+
+#endif
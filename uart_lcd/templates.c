@@ -0,0 +1,222 @@
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include <flash_store.h>
+
+#include "templates.h"
+
+struct TemplateStore {
+    uint32_t version;
+    uint8_t count;
+    // Index of the active template, or -1 if there isn't one
+    int8_t active;
+    struct Template templates[TEMPLATE_MAX_COUNT];
+};
+
+static const struct FlashStore templates_flash_store = {
+    .offset = TEMPLATES_FLASH_OFFSET,
+    .slot_size = TEMPLATES_SLOT_SIZE
+};
+
+static struct TemplateStore store = {.version = TEMPLATES_VERSION, .count = 0, .active = -1};
+
+struct Template *template_find(const char *name) {
+    for (int i = 0; i < store.count; i++) {
+        if (strcmp(store.templates[i].name, name) == 0) {
+            return &store.templates[i];
+        }
+    }
+    return NULL;
+}
+
+struct Template *template_create(const char *name) {
+    if (strlen(name) > TEMPLATE_NAME_MAX_CHARS) {
+        return NULL;
+    }
+
+    struct Template *template = template_find(name);
+    if (template == NULL) {
+        if (store.count == TEMPLATE_MAX_COUNT) {
+            return NULL;
+        }
+        template = &store.templates[store.count++];
+    }
+    if (store.active == template - store.templates) {
+        // The active template's layout no longer matches what is on the display
+        store.active = -1;
+    }
+
+    strcpy(template->name, name);
+    template->field_count = 0;
+    memset(template->text, ' ', sizeof(template->text));
+    return template;
+}
+
+bool template_delete(const char *name) {
+    struct Template *template = template_find(name);
+    if (template == NULL) {
+        return false;
+    }
+
+    int index = template - store.templates;
+    if (store.active == index) {
+        store.active = -1;
+    } else if (store.active > index) {
+        store.active--;
+    }
+    memmove(template, template + 1, (store.count - index - 1) * sizeof(struct Template));
+    store.count--;
+    return true;
+}
+
+int template_count(void) {
+    return store.count;
+}
+
+const struct Template *template_get(int index) {
+    return &store.templates[index];
+}
+
+void template_set_text(struct Template *template, struct LCDPosition position, const char *text) {
+    for (int x = position.offset; x < LCD_SCREEN_MAX_WIDTH && *text != '\0'; x++) {
+        template->text[position.line][x] = *text++;
+    }
+}
+
+bool template_set_field(struct Template *template, const char *name,
+        struct LCDPosition position, uint8_t width, enum LCDAlignment alignment, char padding) {
+    if (strlen(name) > TEMPLATE_NAME_MAX_CHARS || position.line >= LCD_SCREEN_MAX_HEIGHT
+            || width == 0 || position.offset + width > LCD_SCREEN_MAX_WIDTH) {
+        return false;
+    }
+
+    struct TemplateField *field = NULL;
+    for (int i = 0; i < template->field_count; i++) {
+        if (strcmp(template->fields[i].name, name) == 0) {
+            field = &template->fields[i];
+            break;
+        }
+    }
+    if (field == NULL) {
+        if (template->field_count == TEMPLATE_MAX_FIELDS) {
+            return false;
+        }
+        field = &template->fields[template->field_count++];
+    }
+
+    strcpy(field->name, name);
+    field->position = position;
+    field->width = width;
+    field->alignment = alignment;
+    field->padding = padding;
+    return true;
+}
+
+/*
+* Fill a field's cells with an aligned value.
+* Cells must have room for the width of the field.
+*/
+static void _template_format_field(const struct TemplateField *field, const char *value, char *cells) {
+    int length = strlen(value);
+    if (length > field->width) {
+        length = field->width;
+    }
+
+    int start = 0;
+    if (field->alignment == LCD_ALIGN_RIGHT) {
+        start = field->width - length;
+    } else if (field->alignment == LCD_ALIGN_CENTRE) {
+        start = (field->width - length) / 2;
+    }
+
+    memset(cells, field->padding, field->width);
+    memcpy(cells + start, value, length);
+}
+
+void template_show(struct LCDSize size, const struct Template *template) {
+    char screen[LCD_SCREEN_MAX_HEIGHT][LCD_SCREEN_MAX_WIDTH];
+    memcpy(screen, template->text, sizeof(screen));
+
+    for (int i = 0; i < template->field_count; i++) {
+        const struct TemplateField *field = &template->fields[i];
+        char cells[LCD_SCREEN_MAX_WIDTH];
+        _template_format_field(field, "", cells);
+        memcpy(&screen[field->position.line][field->position.offset], cells, field->width);
+    }
+
+    for (int y = 0; y < size.height; y++) {
+        lcd_update(size, (struct LCDPosition){.line = y, .offset = 0}, screen[y], size.width);
+    }
+
+    store.active = template - store.templates;
+}
+
+const struct Template *template_get_active(void) {
+    return store.active == -1 ? NULL : &store.templates[store.active];
+}
+
+void template_clear_active(void) {
+    store.active = -1;
+}
+
+bool template_update_field(struct LCDSize size, const char *name, const char *value) {
+    const struct Template *template = template_get_active();
+    if (template == NULL) {
+        return false;
+    }
+
+    for (int i = 0; i < template->field_count; i++) {
+        const struct TemplateField *field = &template->fields[i];
+        if (strcmp(field->name, name) == 0) {
+            if (field->position.line >= size.height) {
+                // Field isn't visible with the current screen size
+                return true;
+            }
+            char cells[LCD_SCREEN_MAX_WIDTH];
+            _template_format_field(field, value, cells);
+            lcd_update(size, field->position, cells, field->width);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool templates_save(void) {
+    return flash_store_save(&templates_flash_store, &store, sizeof(store));
+}
+
+/*
+* Check that templates loaded from flash were saved by this version and are all within bounds,
+* so nothing indexes past the end of an array however they were corrupted.
+*/
+static bool _templates_valid(const struct TemplateStore *loaded) {
+    if (loaded->version != TEMPLATES_VERSION || loaded->count > TEMPLATE_MAX_COUNT
+            || loaded->active < -1 || loaded->active >= loaded->count) {
+        return false;
+    }
+
+    for (int i = 0; i < loaded->count; i++) {
+        const struct Template *template = &loaded->templates[i];
+        if (memchr(template->name, '\0', sizeof(template->name)) == NULL
+                || template->field_count > TEMPLATE_MAX_FIELDS) {
+            return false;
+        }
+        for (int j = 0; j < template->field_count; j++) {
+            const struct TemplateField *field = &template->fields[j];
+            if (memchr(field->name, '\0', sizeof(field->name)) == NULL
+                    || field->position.line >= LCD_SCREEN_MAX_HEIGHT
+                    || field->width == 0 || field->position.offset + field->width > LCD_SCREEN_MAX_WIDTH
+                    || field->alignment > LCD_ALIGN_RIGHT) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void templates_load(void) {
+    struct TemplateStore loaded;
+    if (flash_store_load(&templates_flash_store, &loaded, sizeof(loaded)) && _templates_valid(&loaded)) {
+        store = loaded;
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef TEMPLATES_H
+#define TEMPLATES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <lcd_controller.h>
+
+#define TEMPLATE_MAX_COUNT 4
+#define TEMPLATE_MAX_FIELDS 8
+#define TEMPLATE_NAME_MAX_CHARS 8
+
+// Templates are kept near the end of flash, just before the settings
+#define TEMPLATES_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - 2 * FLASH_STORE_SIZE)
+#define TEMPLATES_SLOT_SIZE 2048
+// Must be incremented whenever the layout of the saved templates changes
+#define TEMPLATES_VERSION 1
+
+/*
+* An area of a template that can be updated by name.
+* Values shorter than the width are aligned within it and filled with padding,
+* values longer than the width are cut off.
+*/
+struct TemplateField {
+    char name[TEMPLATE_NAME_MAX_CHARS + 1];
+    struct LCDPosition position;
+    uint8_t width;
+    uint8_t alignment;
+    char padding;
+};
+
+/*
+* A screen layout made up of static text and named fields.
+*/
+struct Template {
+    char name[TEMPLATE_NAME_MAX_CHARS + 1];
+    uint8_t field_count;
+    struct TemplateField fields[TEMPLATE_MAX_FIELDS];
+    // Custom characters are represented by \x01 through \x08 inclusive
+    char text[LCD_SCREEN_MAX_HEIGHT][LCD_SCREEN_MAX_WIDTH];
+};
+
+/*
+* Get a template by name. Returns NULL if there is no template with that name.
+*/
+struct Template *template_find(const char *name);
+
+/*
+* Create a template with no text or fields, replacing any existing template with the same name.
+* Returns NULL if the name is too long or there is no room for another template.
+*/
+struct Template *template_create(const char *name);
+
+/*
+* Delete a template. Returns false if there is no template with that name.
+*/
+bool template_delete(const char *name);
+
+/*
+* Get the number of templates, and each template by index.
+*/
+int template_count(void);
+const struct Template *template_get(int index);
+
+/*
+* Set part of the static text of a template. Text past the end of the line is ignored.
+*/
+void template_set_text(struct Template *template, struct LCDPosition position, const char *text);
+
+/*
+* Add a field to a template, replacing any existing field with the same name.
+* Returns false if the name is too long, the field doesn't fit within LCD_SCREEN_MAX_WIDTH,
+* or the template has no room for another field.
+*/
+bool template_set_field(struct Template *template, const char *name,
+    struct LCDPosition position, uint8_t width, enum LCDAlignment alignment, char padding);
+
+/*
+* Draw a template on the display with all of its fields empty,
+* and make it the template that template_update_field updates.
+* Only characters that differ from what is already on the display are sent.
+*/
+void template_show(struct LCDSize size, const struct Template *template);
+
+/*
+* Get the template most recently shown, or NULL if there isn't one.
+*/
+const struct Template *template_get_active(void);
+
+/*
+* Stop treating the template most recently shown as being on the display,
+* for when something else has been drawn over it.
+*/
+void template_clear_active(void);
+
+/*
+* Set the value of a field in the template most recently shown.
+* Only characters that differ from what is already on the display are sent.
+* Returns false if there is no active template or it has no field with that name.
+*/
+bool template_update_field(struct LCDSize size, const char *name, const char *value);
+
+/*
+* Save every template, and which one is active, to flash.
+* Returns false if the save failed.
+*/
+bool templates_save(void);
+
+/*
+* Load the templates saved in flash, if there are any.
+*/
+void templates_load(void);
+
+#endif
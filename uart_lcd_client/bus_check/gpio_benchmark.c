@@ -0,0 +1,82 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include <hd44780_emulator.h>
+#include <lcd_controller.h>
+
+#include "pico_sim.h"
+
+// Compares the 8-bit and 4-bit GPIO interfaces by running lcd_bus_gpio against an emulated display,
+// counting enable cycles and the simulated time taken by a full screen refresh.
+
+#define REFRESH_COUNT 10
+
+struct BenchmarkResult {
+    uint32_t enable_cycles;
+    uint32_t data_writes;
+    uint64_t time_us;
+};
+
+static struct HD44780Emulator display;
+
+static bool run_benchmark(enum LCDInterface interface, struct LCDSize size, struct BenchmarkResult *result) {
+    hd44780_emulator_init(&display);
+    pico_sim_connect_gpio(&display);
+    lcd_init_gpio(interface);
+    lcd_initialise_display(true, false);
+    lcd_display_set(true, false, false);
+
+    uint32_t enable_cycles = display.enable_cycles;
+    uint32_t data_writes = display.data_writes;
+    uint64_t start_us = time_us_64();
+
+    // Each refresh changes every character, so none can be skipped
+    char text[LCD_SCREEN_MAX_WIDTH];
+    for (int refresh = 0; refresh < REFRESH_COUNT; refresh++) {
+        for (uint8_t line = 0; line < size.height; line++) {
+            for (int i = 0; i < size.width; i++) {
+                text[i] = 'A' + (refresh + line + i) % 26;
+            }
+            lcd_update(size, (struct LCDPosition){.line = line, .offset = 0}, text, size.width);
+        }
+    }
+
+    result->enable_cycles = (display.enable_cycles - enable_cycles) / REFRESH_COUNT;
+    result->data_writes = (display.data_writes - data_writes) / REFRESH_COUNT;
+    result->time_us = (time_us_64() - start_us) / REFRESH_COUNT;
+
+    const struct LCDState *state = lcd_get_state();
+    if (memcmp(display.ddram, state->ddram, HD44780_DDRAM_SIZE) != 0 || display.address != state->address) {
+        printf("The display's memory doesn't match the stored state in %s mode.\n",
+            interface == LCD_INTERFACE_4BIT ? "4-bit" : "8-bit");
+        return false;
+    }
+    return true;
+}
+
+int main(void) {
+    struct LCDSize size = {.width = 20, .height = 4};
+    struct BenchmarkResult eight_bit;
+    struct BenchmarkResult four_bit;
+    if (!run_benchmark(LCD_INTERFACE_8BIT, size, &eight_bit)
+            || !run_benchmark(LCD_INTERFACE_4BIT, size, &four_bit)) {
+        return 1;
+    }
+
+    printf("Full %" PRIu8 "x%" PRIu8 " refresh over GPIO, averaged over %d refreshes.\n",
+        size.width, size.height, REFRESH_COUNT);
+    printf("Enable cycles include polling the busy flag while each instruction executes:\n");
+    printf("  8-bit: %5" PRIu32 " enable cycles, %3" PRIu32 " characters, %5" PRIu64 "us\n",
+        eight_bit.enable_cycles, eight_bit.data_writes, eight_bit.time_us);
+    printf("  4-bit: %5" PRIu32 " enable cycles, %3" PRIu32 " characters, %5" PRIu64 "us\n",
+        four_bit.enable_cycles, four_bit.data_writes, four_bit.time_us);
+    printf("  4-bit takes %.2f times as long as 8-bit\n", (double)four_bit.time_us / eight_bit.time_us);
+
+    if (eight_bit.data_writes != four_bit.data_writes || four_bit.time_us < eight_bit.time_us) {
+        printf("The interfaces didn't do the same work.\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,29 @@
+#ifndef HARDWARE_I2C_H
+#define HARDWARE_I2C_H
+
+#include "pico/stdlib.h"
+
+// Only the registers used by lcd_bus_pcf8574
+typedef struct {
+    volatile uint32_t enable;
+    volatile uint32_t tar;
+    volatile uint32_t data_cmd;
+    volatile uint32_t raw_intr_stat;
+    volatile uint32_t clr_tx_abrt;
+    volatile uint32_t clr_stop_det;
+} i2c_hw_t;
+
+typedef struct i2c_inst i2c_inst_t;
+
+extern i2c_inst_t i2c1_inst;
+#define i2c1 (&i2c1_inst)
+
+#define I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS 0x00000040
+#define I2C_IC_RAW_INTR_STAT_STOP_DET_BITS 0x00000200
+#define I2C_IC_DATA_CMD_STOP_BITS 0x00000200
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c);
+uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx);
+
+#endif
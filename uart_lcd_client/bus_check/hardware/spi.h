@@ -0,0 +1,38 @@
+#ifndef HARDWARE_SPI_H
+#define HARDWARE_SPI_H
+
+#include "pico/stdlib.h"
+
+// Only the registers used by lcd_bus_74hc595
+typedef struct {
+    volatile uint32_t dr;
+} spi_hw_t;
+
+typedef struct spi_inst spi_inst_t;
+
+extern spi_inst_t spi0_inst;
+#define spi0 (&spi0_inst)
+
+typedef enum {
+    SPI_CPOL_0 = 0,
+    SPI_CPOL_1 = 1
+} spi_cpol_t;
+
+typedef enum {
+    SPI_CPHA_0 = 0,
+    SPI_CPHA_1 = 1
+} spi_cpha_t;
+
+typedef enum {
+    SPI_LSB_FIRST = 0,
+    SPI_MSB_FIRST = 1
+} spi_order_t;
+
+uint spi_init(spi_inst_t *spi, uint baudrate);
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order);
+spi_hw_t *spi_get_hw(spi_inst_t *spi);
+uint spi_get_dreq(spi_inst_t *spi, bool is_tx);
+// Transfers finish as soon as they start, so this is always false
+bool spi_is_busy(const spi_inst_t *spi);
+
+#endif
@@ -0,0 +1,102 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include <hd44780_emulator.h>
+#include <lcd_controller.h>
+
+#include "pico_sim.h"
+
+// Resets and hangs an emulated display connected through lcd_bus_gpio, checking that
+// lcd_check_health notices and puts back everything the display lost.
+
+static struct HD44780Emulator display;
+
+static bool check_restored(const char *step, struct LCDSize size, const char *expected) {
+    const struct LCDState *state = lcd_get_state();
+    if (memcmp(display.ddram, state->ddram, HD44780_DDRAM_SIZE) != 0
+            || memcmp(display.cgram, state->cgram, HD44780_CGRAM_SIZE) != 0
+            || display.address != state->address
+            || display.cgram_selected != state->cgram_selected
+            || display.function_set != state->function_set
+            || display.display_control != state->display_control
+            || display.entry_mode != state->entry_mode) {
+        printf("%s: the display doesn't match the stored state.\n", step);
+        return false;
+    }
+
+    char shown[LCD_STRING_MAX_CHARS];
+    hd44780_emulator_read(&display, size.width, size.height, shown);
+    if (strcmp(shown, expected) != 0) {
+        printf("%s: the display shows\n%s\ninstead of\n%s\n", step, shown, expected);
+        return false;
+    }
+    return true;
+}
+
+static bool check_health(const char *step, uint32_t faults_detected, uint32_t recoveries) {
+    struct LCDHealth health = lcd_get_health();
+    if (health.faults_detected != faults_detected || health.recoveries != recoveries
+            || health.failed_recoveries != 0) {
+        printf("%s: %" PRIu32 " faults detected, %" PRIu32 " recoveries and %" PRIu32
+            " failed recoveries, instead of %" PRIu32 " and %" PRIu32 ".\n",
+            step, health.faults_detected, health.recoveries, health.failed_recoveries,
+            faults_detected, recoveries);
+        return false;
+    }
+    return true;
+}
+
+int main(void) {
+    hd44780_emulator_init(&display);
+    pico_sim_connect_gpio(&display);
+    lcd_init_gpio(LCD_INTERFACE_4BIT);
+
+    struct LCDSize size = {.width = 20, .height = 4};
+    lcd_initialise_display(true, false);
+    lcd_display_set(true, true, false);
+    uint8_t pixels[8] = {0b00100, 0b01110, 0b11111, 0b00100, 0b00100, 0b00100, 0b00100, 0};
+    lcd_define_custom_char(2, pixels);
+    lcd_write(size, "Hello \x03\nworld");
+
+    // Nothing is wrong yet
+    lcd_check_health();
+    if (!check_health("Healthy display", 0, 0)) {
+        return 1;
+    }
+
+    // A display that resets itself (e.g. from a brownout) loses everything
+    hd44780_emulator_init(&display);
+    pico_sim_connect_gpio(&display);
+    lcd_check_health();
+    if (!check_health("Reset display", 1, 1)
+            || !check_restored("Reset display", size,
+                "Hello \x03             \nworld               \n                    \n                    ")) {
+        return 1;
+    }
+
+    // Writes to a hung display should give up once, rather than waiting out the timeout for every one
+    pico_sim_hang_display(true);
+    uint64_t start_us = time_us_64();
+    lcd_clear();
+    lcd_write(size, "The display stopped responding while this was being written to it");
+    uint64_t hung_us = time_us_64() - start_us;
+    if (hung_us > 2 * LCD_BUSY_TIMEOUT_US || lcd_get_health().busy_timeouts != 1) {
+        printf("Writing to a hung display took %" PRIu64 "us, with %" PRIu32 " busy timeouts.\n",
+            hung_us, lcd_get_health().busy_timeouts);
+        return 1;
+    }
+
+    // Once it responds again, it gets everything written while it was hung
+    pico_sim_hang_display(false);
+    lcd_check_health();
+    if (!check_health("Hung display", 2, 2)
+            || !check_restored("Hung display", size,
+                "The display stopped \nresponding while thi\ns was being written \nto it               ")) {
+        return 1;
+    }
+
+    printf("Display health check passed.\n");
+    return 0;
+}
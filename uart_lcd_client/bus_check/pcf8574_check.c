@@ -0,0 +1,140 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include <hd44780_emulator.h>
+#include <lcd_controller.h>
+#include <pcf8574_emulator.h>
+
+#include "pico_sim.h"
+
+// Drives lcd_bus_pcf8574's queued I2C transfers through an emulated backpack and display,
+// checking the display ends up with what the controller believes it is showing.
+
+static struct HD44780Emulator display;
+static struct PCF8574Emulator expander;
+
+static bool check_display(const char *step, struct LCDSize size, const char *expected) {
+    const struct LCDState *state = lcd_get_state();
+    if (memcmp(display.ddram, state->ddram, HD44780_DDRAM_SIZE) != 0
+            || memcmp(display.cgram, state->cgram, HD44780_CGRAM_SIZE) != 0
+            || display.address != state->address) {
+        printf("%s: the display's memory doesn't match the stored state.\n", step);
+        return false;
+    }
+
+    char shown[LCD_STRING_MAX_CHARS];
+    hd44780_emulator_read(&display, size.width, size.height, shown);
+    if (strcmp(shown, expected) != 0) {
+        printf("%s: the display shows\n%s\ninstead of\n%s\n", step, shown, expected);
+        return false;
+    }
+    return true;
+}
+
+int main(void) {
+    hd44780_emulator_init(&display);
+    pcf8574_emulator_init(&expander, &display);
+    pico_sim_connect_i2c(&expander);
+
+    lcd_init_pcf8574(LCD_PCF8574_DEFAULT_ADDRESS);
+    if (pico_sim_get_i2c_target() != LCD_PCF8574_DEFAULT_ADDRESS) {
+        printf("The I2C controller wasn't set up to talk to the backpack.\n");
+        return 1;
+    }
+
+    struct LCDSize size = {.width = 20, .height = 4};
+    lcd_initialise_display(true, false);
+    lcd_display_set(true, false, false);
+    uint8_t pixels[8] = {0b00100, 0b01110, 0b11111, 0b00100, 0b00100, 0b00100, 0b00100, 0};
+    lcd_define_custom_char(2, pixels);
+    lcd_flush();
+    if (!display.four_bit || !(display.function_set & 0b1000)) {
+        printf("The display wasn't initialised in 4-bit, 2 line mode.\n");
+        return 1;
+    }
+
+    // A full refresh, which should fit in a single transaction
+    char text[LCD_SCREEN_MAX_CHARS + 1];
+    for (int i = 0; i < LCD_SCREEN_MAX_CHARS; i++) {
+        text[i] = 'A' + i % 26;
+    }
+    text[LCD_SCREEN_MAX_CHARS] = '\0';
+    text[25] = '\x03';
+    uint32_t transactions = expander.transactions;
+    uint32_t bytes = expander.bytes;
+    uint64_t start_us = time_us_64();
+    for (uint8_t line = 0; line < size.height; line++) {
+        lcd_update(size, (struct LCDPosition){.line = line, .offset = 0}, text + line * size.width, size.width);
+    }
+    lcd_flush();
+    printf("Full 20x4 refresh: %" PRIu32 " transactions, %" PRIu32 " bytes, %" PRIu64 "us\n",
+        expander.transactions - transactions, expander.bytes - bytes, time_us_64() - start_us);
+
+    char expected[LCD_STRING_MAX_CHARS] = "";
+    for (int line = 0; line < size.height; line++) {
+        strncat(expected, text + line * size.width, size.width);
+        if (line != size.height - 1) {
+            strcat(expected, "\n");
+        }
+    }
+    if (!check_display("Full refresh", size, expected)) {
+        return 1;
+    }
+
+    // Only the changed characters should be sent
+    uint32_t data_writes = display.data_writes;
+    lcd_update(size, (struct LCDPosition){.line = 2, .offset = 5}, "xy", 2);
+    lcd_flush();
+    if (display.data_writes - data_writes != 2) {
+        printf("Updating 2 characters wrote %" PRIu32 " characters.\n", display.data_writes - data_writes);
+        return 1;
+    }
+    memcpy(expected + 2 * (size.width + 1) + 5, "xy", 2);
+    if (!check_display("Partial update", size, expected)) {
+        return 1;
+    }
+
+    lcd_clear();
+    lcd_write(size, "Hello\nworld");
+    lcd_flush();
+    if (!check_display("Clear and write", size,
+            "Hello               \nworld               \n                    \n                    ")) {
+        return 1;
+    }
+
+    // An unplugged backpack is reported by the bus, and the display is restored once it's back
+    pico_sim_connect_i2c(NULL);
+    lcd_write(size, "!");
+    lcd_flush();
+    pcf8574_emulator_init(&expander, &display);
+    hd44780_emulator_init(&display);
+    pico_sim_connect_i2c(&expander);
+    lcd_check_health();
+    struct LCDHealth health = lcd_get_health();
+    if (health.bus_errors == 0 || health.faults_detected != 1 || health.recoveries != 1) {
+        printf("Unplugging the backpack gave %" PRIu32 " bus errors, %" PRIu32 " faults, and %" PRIu32
+            " recoveries.\n", health.bus_errors, health.faults_detected, health.recoveries);
+        return 1;
+    }
+    if (!check_display("Reconnected backpack", size,
+            "Hello               \nworld!              \n                    \n                    ")) {
+        return 1;
+    }
+
+    // Settings saved by a build using the 8-bit GPIO interface should still restore in 4-bit mode
+    struct LCDState saved = *lcd_get_state();
+    saved.function_set |= 0b10000;
+    if (!lcd_restore_state(&saved) || !display.four_bit) {
+        printf("Restoring 8-bit settings didn't keep the display in 4-bit mode.\n");
+        return 1;
+    }
+    if (!check_display("Restored 8-bit settings", size,
+            "Hello               \nworld!              \n                    \n                    ")) {
+        return 1;
+    }
+
+    printf("PCF8574 bus check passed.\n");
+    return 0;
+}
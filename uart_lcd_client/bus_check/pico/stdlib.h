@@ -0,0 +1,36 @@
+#ifndef PICO_STDLIB_H
+#define PICO_STDLIB_H
+
+// The small part of the Pico SDK used by the display buses, implemented for a host
+// with a simulated clock, so the bus backends can be run against emulated hardware.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+#define GPIO_OUT 1
+#define GPIO_IN 0
+
+enum gpio_function {
+    GPIO_FUNC_SPI = 1,
+    GPIO_FUNC_I2C = 3
+};
+
+uint64_t time_us_64(void);
+// Moves the simulated clock on without waiting
+void sleep_us(uint64_t us);
+
+void gpio_init(uint gpio);
+void gpio_init_mask(uint32_t mask);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_set_dir_out_masked(uint32_t mask);
+void gpio_set_dir_in_masked(uint32_t mask);
+void gpio_put(uint gpio, bool value);
+void gpio_put_masked(uint32_t mask, uint32_t value);
+uint32_t gpio_get_all(void);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+void gpio_pull_up(uint gpio);
+
+#endif
@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/i2c.h"
+#include "hardware/spi.h"
+
+#include <lcd_bus.h>
+#include <lcd_controller.h>
+
+#include "pico_sim.h"
+
+// An I2C byte takes 9 clock cycles including the acknowledge bit
+#define I2C_BITS_PER_BYTE 9
+
+struct i2c_inst {
+    i2c_hw_t hw;
+    uint baudrate;
+};
+
+i2c_inst_t i2c1_inst;
+
+struct spi_inst {
+    spi_hw_t hw;
+    uint baudrate;
+};
+
+spi_inst_t spi0_inst;
+
+static uint64_t now_us = 0;
+
+static struct PCF8574Emulator *i2c_expander = NULL;
+
+static struct PCF8574Emulator *spi_shift_register = NULL;
+static struct PicoSimSPIStats spi_stats = {0};
+static uint64_t spi_busy_until_ns = 0;
+static uint8_t spi_upper_nibble = 0;
+
+static struct HD44780Emulator *gpio_display = NULL;
+static uint32_t gpio_outputs = 0;
+// Pins set as inputs
+static uint32_t gpio_input_mask = 0;
+// What the display puts on D7-D0 while enable is high for a read
+static uint8_t display_output = 0;
+static uint64_t display_busy_until = 0;
+static uint8_t display_upper_nibble = 0;
+static bool display_hung = false;
+
+uint64_t time_us_64(void) {
+    return now_us;
+}
+
+void sleep_us(uint64_t us) {
+    now_us += us;
+}
+
+void pico_sim_connect_gpio(struct HD44780Emulator *display) {
+    gpio_display = display;
+    display_busy_until = 0;
+    display_hung = false;
+}
+
+void pico_sim_hang_display(bool hung) {
+    display_hung = hung;
+}
+
+void gpio_init(uint gpio) {
+    gpio_init_mask(1u << gpio);
+}
+
+void gpio_init_mask(uint32_t mask) {
+    gpio_input_mask |= mask;
+    gpio_outputs &= ~mask;
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+    if (out) {
+        gpio_set_dir_out_masked(1u << gpio);
+    } else {
+        gpio_set_dir_in_masked(1u << gpio);
+    }
+}
+
+void gpio_set_dir_out_masked(uint32_t mask) {
+    gpio_input_mask &= ~mask;
+}
+
+void gpio_set_dir_in_masked(uint32_t mask) {
+    gpio_input_mask |= mask;
+}
+
+static bool _sim_gpio_get_output(uint gpio) {
+    return gpio_outputs & (1u << gpio);
+}
+
+/*
+* The display reads from the data pins when enable goes low, and puts data on them when it goes high.
+*/
+static void _sim_gpio_cycle_display(bool enable) {
+    bool rs_value = _sim_gpio_get_output(LCD_RS_PIN);
+    bool rw_value = _sim_gpio_get_output(LCD_RW_PIN);
+    // In 4-bit mode, whether this cycle transfers the first half of a byte
+    bool first_nibble = !gpio_display->four_bit || !gpio_display->lower_nibble_next;
+
+    if (enable && rw_value) {
+        display_output = hd44780_emulator_cycle_enable(gpio_display, rs_value, true, 0);
+        if (!rs_value && first_nibble && (display_hung || time_us_64() < display_busy_until)) {
+            display_output |= 0b10000000;
+        }
+    } else if (!enable && !rw_value && !display_hung) {
+        uint8_t data_pins = gpio_outputs >> LCD_DATA_PIN_START;
+        hd44780_emulator_cycle_enable(gpio_display, rs_value, false, data_pins);
+        if (gpio_display->four_bit && first_nibble) {
+            display_upper_nibble = data_pins & 0b11110000;
+            return;
+        }
+
+        // The whole byte has arrived, and the display is busy until it has been executed
+        uint8_t data = first_nibble ? data_pins : display_upper_nibble | (data_pins >> 4);
+        bool long_instruction = !rs_value && data != 0 && data < 0b100;
+        display_busy_until = time_us_64() + (long_instruction ? LCD_LONG_SLEEP_US : LCD_SHORT_SLEEP_US);
+    }
+}
+
+void gpio_put(uint gpio, bool value) {
+    bool previous = _sim_gpio_get_output(gpio);
+    if (value) {
+        gpio_outputs |= 1u << gpio;
+    } else {
+        gpio_outputs &= ~(1u << gpio);
+    }
+
+    if (gpio == LCD_E_PIN && value != previous && gpio_display != NULL) {
+        _sim_gpio_cycle_display(value);
+    }
+}
+
+void gpio_put_masked(uint32_t mask, uint32_t value) {
+    gpio_outputs = (gpio_outputs & ~mask) | (value & mask);
+}
+
+uint32_t gpio_get_all(void) {
+    return (gpio_outputs & ~gpio_input_mask)
+        | (((uint32_t)display_output << LCD_DATA_PIN_START) & gpio_input_mask);
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+    (void)gpio;
+    (void)fn;
+}
+
+void gpio_pull_up(uint gpio) {
+    (void)gpio;
+}
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) {
+    i2c->baudrate = baudrate;
+    // Every transfer finishes as soon as it starts, so a stop condition is always waiting
+    i2c->hw.raw_intr_stat = I2C_IC_RAW_INTR_STAT_STOP_DET_BITS;
+    return baudrate;
+}
+
+i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c) {
+    return &i2c->hw;
+}
+
+uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx) {
+    (void)i2c;
+    (void)is_tx;
+    return 0;
+}
+
+void pico_sim_connect_i2c(struct PCF8574Emulator *expander) {
+    i2c_expander = expander;
+}
+
+uint32_t pico_sim_get_i2c_target(void) {
+    return i2c1_inst.hw.tar;
+}
+
+uint spi_init(spi_inst_t *spi, uint baudrate) {
+    spi->baudrate = baudrate;
+    return baudrate;
+}
+
+void spi_set_format(spi_inst_t *spi, uint data_bits, spi_cpol_t cpol, spi_cpha_t cpha, spi_order_t order) {
+    // Chip select only pulses between bytes, latching each one, with CPHA 0
+    if (data_bits != 8 || cpha != SPI_CPHA_0 || order != SPI_MSB_FIRST) {
+        fprintf(stderr, "SPI format doesn't latch each byte into the shift register\n");
+        exit(1);
+    }
+    (void)spi;
+    (void)cpol;
+}
+
+spi_hw_t *spi_get_hw(spi_inst_t *spi) {
+    return &spi->hw;
+}
+
+uint spi_get_dreq(spi_inst_t *spi, bool is_tx) {
+    (void)spi;
+    (void)is_tx;
+    return 0;
+}
+
+bool spi_is_busy(const spi_inst_t *spi) {
+    (void)spi;
+    return false;
+}
+
+void pico_sim_connect_spi(struct PCF8574Emulator *shift_register) {
+    spi_shift_register = shift_register;
+    spi_stats = (struct PicoSimSPIStats){0};
+    spi_busy_until_ns = 0;
+}
+
+struct PicoSimSPIStats pico_sim_get_spi_stats(void) {
+    return spi_stats;
+}
+
+int dma_claim_unused_channel(bool required) {
+    (void)required;
+    return 0;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    (void)channel;
+    return (dma_channel_config){0};
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config *config, enum dma_channel_transfer_size size) {
+    config->ctrl = (config->ctrl & ~0b11) | size;
+}
+
+void channel_config_set_read_increment(dma_channel_config *config, bool increment) {
+    (void)config;
+    (void)increment;
+}
+
+void channel_config_set_write_increment(dma_channel_config *config, bool increment) {
+    (void)config;
+    (void)increment;
+}
+
+void channel_config_set_dreq(dma_channel_config *config, uint dreq) {
+    (void)config;
+    (void)dreq;
+}
+
+static void _sim_i2c_transfer(const uint16_t *entries, uint count) {
+    uint8_t data[count];
+    for (uint i = 0; i < count; i++) {
+        // Only the last byte of a transaction should end it with a stop condition
+        if ((entries[i] & I2C_IC_DATA_CMD_STOP_BITS) != (i == count - 1 ? I2C_IC_DATA_CMD_STOP_BITS : 0)) {
+            fprintf(stderr, "I2C transfer has a stop condition in the wrong place\n");
+            exit(1);
+        }
+        data[i] = entries[i] & 0xFF;
+    }
+
+    if (i2c_expander == NULL) {
+        // Nothing acknowledges the address, so the controller gives up after sending it
+        i2c1_inst.hw.raw_intr_stat |= I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS;
+        now_us += (I2C_BITS_PER_BYTE * 1000000 + i2c1_inst.baudrate - 1) / i2c1_inst.baudrate;
+        return;
+    }
+
+    // Reading clr_tx_abrt can't be seen here, so an abort is cleared by the next transfer instead
+    i2c1_inst.hw.raw_intr_stat &= ~I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS;
+    pcf8574_emulator_write(i2c_expander, data, count);
+    now_us += ((uint64_t)count * I2C_BITS_PER_BYTE * 1000000 + i2c1_inst.baudrate - 1) / i2c1_inst.baudrate;
+}
+
+static void _sim_spi_transfer(const uint8_t *data, uint count) {
+    spi_stats.transfers++;
+    spi_stats.bytes += count;
+    uint64_t byte_time_ns = 8 * 1000000000ull / spi0_inst.baudrate;
+    uint64_t start_ns = now_us * 1000;
+
+    for (uint i = 0; i < count && spi_shift_register != NULL; i++) {
+        struct HD44780Emulator *display = spi_shift_register->display;
+        uint64_t latched_ns = start_ns + (i + 1) * byte_time_ns;
+        bool four_bit = display->four_bit;
+        // In 4-bit mode, whether the next enable cycle transfers the first half of a byte
+        bool first_nibble = !four_bit || !display->lower_nibble_next;
+        uint32_t enable_cycles = display->enable_cycles;
+
+        pcf8574_emulator_write(spi_shift_register, &data[i], 1);
+        if (display->enable_cycles == enable_cycles) {
+            continue;
+        }
+
+        if (first_nibble && latched_ns < spi_busy_until_ns) {
+            spi_stats.early_writes++;
+        }
+        uint8_t nibble = data[i] & 0b11110000;
+        if (four_bit && first_nibble) {
+            spi_upper_nibble = nibble;
+            continue;
+        }
+        // The whole byte has arrived, and the display is busy until it has been executed
+        uint8_t value = four_bit ? spi_upper_nibble | (nibble >> 4) : nibble;
+        bool rs_value = data[i] & 0b1;
+        bool long_instruction = !rs_value && value != 0 && value < 0b100;
+        spi_busy_until_ns = latched_ns + (long_instruction ? LCD_LONG_SLEEP_US : LCD_SHORT_SLEEP_US) * 1000;
+    }
+    now_us += (count * byte_time_ns + 999) / 1000;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+        const volatile void *read_addr, uint transfer_count, bool trigger) {
+    (void)channel;
+    if (!trigger || transfer_count == 0) {
+        return;
+    }
+    if (write_addr == &i2c1_inst.hw.data_cmd && (config->ctrl & 0b11) == DMA_SIZE_16) {
+        _sim_i2c_transfer((const uint16_t *)read_addr, transfer_count);
+        return;
+    }
+    if (write_addr == &spi0_inst.hw.dr && (config->ctrl & 0b11) == DMA_SIZE_8) {
+        _sim_spi_transfer((const uint8_t *)read_addr, transfer_count);
+        return;
+    }
+    fprintf(stderr, "DMA transfer to a peripheral that isn't simulated\n");
+    exit(1);
+}
+
+bool dma_channel_is_busy(uint channel) {
+    (void)channel;
+    return false;
+}
+
+void dma_channel_wait_for_finish_blocking(uint channel) {
+    (void)channel;
+}
+
+void dma_channel_abort(uint channel) {
+    (void)channel;
+}
+
+// The backlight on LCD_A_PIN isn't simulated, so fades finish immediately
+static uint8_t backlight_level = 0;
+
+void _lcd_pwm_backlight_init(void) {
+    backlight_level = 0;
+}
+
+void _lcd_pwm_backlight_fade(uint8_t level, uint32_t fade_ms) {
+    backlight_level = level;
+}
+
+void _lcd_pwm_backlight_breathe(uint8_t level, uint32_t period_ms) {
+    backlight_level = level;
+}
+
+uint8_t _lcd_pwm_backlight_get_level(void) {
+    return backlight_level;
+}
@@ -0,0 +1,52 @@
+#ifndef PICO_SIM_H
+#define PICO_SIM_H
+
+#include <hd44780_emulator.h>
+#include <pcf8574_emulator.h>
+
+/*
+* Wire an emulated display to the simulated GPIO pins, the same way lcd_bus_gpio expects.
+* The display's busy flag stays set for as long as a real display takes to execute each instruction,
+* so time spent polling it shows up on the simulated clock.
+*/
+void pico_sim_connect_gpio(struct HD44780Emulator *display);
+
+/*
+* Make the display connected to the GPIO pins stop responding, leaving its busy flag set and ignoring writes,
+* or start responding again.
+*/
+void pico_sim_hang_display(bool hung);
+
+/*
+* Connect the simulated I2C controller to an emulated PCF8574 backpack.
+* Each DMA transfer to the controller reaches the expander as a single transaction,
+* and moves the simulated clock on by the time it would take at the configured baud rate.
+* With no expander connected, transfers are aborted as if the backpack were unplugged.
+*/
+void pico_sim_connect_i2c(struct PCF8574Emulator *expander);
+
+/*
+* Get the address the I2C controller was last set up to talk to.
+*/
+uint32_t pico_sim_get_i2c_target(void);
+
+struct PicoSimSPIStats {
+    uint32_t transfers;
+    uint32_t bytes;
+    // Bytes that reached the display while it was still executing the previous instruction
+    uint32_t early_writes;
+};
+
+/*
+* Connect the simulated SPI controller to a 74HC595 shift register, wired to the display the same way
+* as a PCF8574 backpack, so the expander emulator stands in for it. Each byte is latched as it arrives,
+* and the simulated clock moves on by the time each DMA transfer would take at the configured baud rate.
+*/
+void pico_sim_connect_spi(struct PCF8574Emulator *shift_register);
+
+/*
+* Get what has been sent over SPI since it was connected.
+*/
+struct PicoSimSPIStats pico_sim_get_spi_stats(void);
+
+#endif
@@ -0,0 +1,113 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include <hd44780_emulator.h>
+#include <lcd_controller.h>
+#include <pcf8574_emulator.h>
+
+#include "pico_sim.h"
+
+// Drives lcd_bus_74hc595's queued SPI transfers through an emulated shift register and display,
+// checking the display ends up with what the controller believes it is showing, and that the
+// padding bytes leave each instruction long enough to execute.
+
+static struct HD44780Emulator display;
+static struct PCF8574Emulator shift_register;
+
+static bool check_display(const char *step, struct LCDSize size, const char *expected) {
+    const struct LCDState *state = lcd_get_state();
+    if (memcmp(display.ddram, state->ddram, HD44780_DDRAM_SIZE) != 0
+            || memcmp(display.cgram, state->cgram, HD44780_CGRAM_SIZE) != 0
+            || display.address != state->address) {
+        printf("%s: the display's memory doesn't match the stored state.\n", step);
+        return false;
+    }
+
+    char shown[LCD_STRING_MAX_CHARS];
+    hd44780_emulator_read(&display, size.width, size.height, shown);
+    if (strcmp(shown, expected) != 0) {
+        printf("%s: the display shows\n%s\ninstead of\n%s\n", step, shown, expected);
+        return false;
+    }
+
+    struct PicoSimSPIStats stats = pico_sim_get_spi_stats();
+    if (stats.early_writes != 0) {
+        printf("%s: %" PRIu32 " bytes reached the display before it was ready.\n", step, stats.early_writes);
+        return false;
+    }
+    return true;
+}
+
+int main(void) {
+    hd44780_emulator_init(&display);
+    pcf8574_emulator_init(&shift_register, &display);
+    pico_sim_connect_spi(&shift_register);
+
+    lcd_init_74hc595();
+
+    struct LCDSize size = {.width = 20, .height = 4};
+    lcd_initialise_display(true, false);
+    lcd_display_set(true, false, false);
+    uint8_t pixels[8] = {0b00100, 0b01110, 0b11111, 0b00100, 0b00100, 0b00100, 0b00100, 0};
+    lcd_define_custom_char(2, pixels);
+    lcd_flush();
+    if (!display.four_bit || !(display.function_set & 0b1000)) {
+        printf("The display wasn't initialised in 4-bit, 2 line mode.\n");
+        return 1;
+    }
+
+    // A full refresh, which should fit in a single transfer
+    char text[LCD_SCREEN_MAX_CHARS + 1];
+    for (int i = 0; i < LCD_SCREEN_MAX_CHARS; i++) {
+        text[i] = 'A' + i % 26;
+    }
+    text[LCD_SCREEN_MAX_CHARS] = '\0';
+    text[25] = '\x03';
+    struct PicoSimSPIStats before = pico_sim_get_spi_stats();
+    uint64_t start_us = time_us_64();
+    for (uint8_t line = 0; line < size.height; line++) {
+        lcd_update(size, (struct LCDPosition){.line = line, .offset = 0}, text + line * size.width, size.width);
+    }
+    lcd_flush();
+    struct PicoSimSPIStats after = pico_sim_get_spi_stats();
+    printf("Full 20x4 refresh: %" PRIu32 " transfers, %" PRIu32 " bytes, %" PRIu64 "us\n",
+        after.transfers - before.transfers, after.bytes - before.bytes, time_us_64() - start_us);
+
+    char expected[LCD_STRING_MAX_CHARS] = "";
+    for (int line = 0; line < size.height; line++) {
+        strncat(expected, text + line * size.width, size.width);
+        if (line != size.height - 1) {
+            strcat(expected, "\n");
+        }
+    }
+    if (!check_display("Full refresh", size, expected)) {
+        return 1;
+    }
+
+    // Only the changed characters should be sent
+    uint32_t data_writes = display.data_writes;
+    lcd_update(size, (struct LCDPosition){.line = 2, .offset = 5}, "xy", 2);
+    lcd_flush();
+    if (display.data_writes - data_writes != 2) {
+        printf("Updating 2 characters wrote %" PRIu32 " characters.\n", display.data_writes - data_writes);
+        return 1;
+    }
+    memcpy(expected + 2 * (size.width + 1) + 5, "xy", 2);
+    if (!check_display("Partial update", size, expected)) {
+        return 1;
+    }
+
+    // Clear takes much longer than other instructions, which has to be covered by padding
+    lcd_clear();
+    lcd_write(size, "Hello\nworld");
+    lcd_flush();
+    if (!check_display("Clear and write", size,
+            "Hello               \nworld               \n                    \n                    ")) {
+        return 1;
+    }
+
+    printf("74HC595 bus check passed.\n");
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <hd44780_emulator.h>
+#include <lcd_bus_emulated.h>
+#include <lcd_controller.h>
+
+// Lays out text in boxes on an emulated display, checking wrapping, alignment and clipping,
+// that nothing outside the box is touched, and that redrawing only sends what differs.
+
+static struct HD44780Emulator display;
+
+static const struct LCDSize size = {.width = 20, .height = 4};
+
+// Fill the screen with dots, so anything written outside a box shows up
+static void fill_screen(void) {
+    char dots[LCD_SCREEN_MAX_CHARS + 1];
+    memset(dots, '.', size.width * size.height);
+    dots[size.width * size.height] = '\0';
+    lcd_set_cursor_position(size, (struct LCDPosition){.line = 0, .offset = 0});
+    lcd_write(size, dots);
+}
+
+static bool check_box(const char *step, struct LCDPosition position, struct LCDSize box,
+        enum LCDAlignment alignment, const char *message, bool fits, const char *expected) {
+    fill_screen();
+    if (lcd_write_box(size, position, box, alignment, message) != fits) {
+        printf("%s: lcd_write_box returned %s.\n", step, fits ? "false" : "true");
+        return false;
+    }
+
+    char shown[LCD_STRING_MAX_CHARS];
+    hd44780_emulator_read(&display, size.width, size.height, shown);
+    if (strcmp(shown, expected) != 0) {
+        printf("%s: the display shows\n%s\ninstead of\n%s\n", step, shown, expected);
+        return false;
+    }
+
+    // Drawing the same box again has nothing to send
+    uint32_t data_writes = display.data_writes;
+    lcd_write_box(size, position, box, alignment, message);
+    if (display.data_writes != data_writes) {
+        printf("%s: redrawing the same box sent %" PRIu32 " characters.\n",
+            step, display.data_writes - data_writes);
+        return false;
+    }
+    return true;
+}
+
+int main(void) {
+    hd44780_emulator_init(&display);
+    lcd_init_emulated(&display, LCD_INTERFACE_8BIT);
+    lcd_initialise_display(true, false);
+    lcd_display_set(true, false, false);
+
+    // Lines are broken between words, and the rest of the box is cleared
+    if (!check_box("Wrapping", (struct LCDPosition){.line = 0, .offset = 2},
+            (struct LCDSize){.width = 10, .height = 3}, LCD_ALIGN_LEFT, "The quick brown fox", true,
+            "..The quick ........\n..brown fox ........\n..          ........\n....................")) {
+        return 1;
+    }
+
+    // Words longer than the box are split
+    if (!check_box("Long word", (struct LCDPosition){.line = 1, .offset = 0},
+            (struct LCDSize){.width = 4, .height = 3}, LCD_ALIGN_LEFT, "abcdefghij", true,
+            "....................\nabcd................\nefgh................\nij  ................")) {
+        return 1;
+    }
+
+    // Each line is aligned on its own
+    if (!check_box("Centre alignment", (struct LCDPosition){.line = 1, .offset = 5},
+            (struct LCDSize){.width = 10, .height = 2}, LCD_ALIGN_CENTRE, "ab\nabc", true,
+            "....................\n.....    ab    .....\n.....   abc    .....\n....................")) {
+        return 1;
+    }
+    if (!check_box("Right alignment", (struct LCDPosition){.line = 3, .offset = 14},
+            (struct LCDSize){.width = 6, .height = 1}, LCD_ALIGN_RIGHT, "xyz", true,
+            "....................\n....................\n....................\n..............   xyz")) {
+        return 1;
+    }
+
+    // Text that doesn't fit in the height of the box is cut off
+    if (!check_box("Too much text", (struct LCDPosition){.line = 0, .offset = 0},
+            (struct LCDSize){.width = 5, .height = 2}, LCD_ALIGN_LEFT, "one two three", false,
+            "one  ...............\ntwo  ...............\n....................\n....................")) {
+        return 1;
+    }
+
+    // So is any part of the box off the screen
+    if (!check_box("Off the screen", (struct LCDPosition){.line = 2, .offset = 16},
+            (struct LCDSize){.width = 10, .height = 5}, LCD_ALIGN_LEFT, "abc defg hi", false,
+            "....................\n....................\n................abc \n................defg")) {
+        return 1;
+    }
+
+    // A word that exactly fills a line, followed by a newline, doesn't leave a blank line
+    if (!check_box("Full width word then newline", (struct LCDPosition){.line = 0, .offset = 0},
+            (struct LCDSize){.width = 5, .height = 2}, LCD_ALIGN_LEFT, "HELLO \nX", true,
+            "HELLO...............\nX    ...............\n....................\n....................")) {
+        return 1;
+    }
+    // But an explicit blank line is kept
+    if (!check_box("Blank line", (struct LCDPosition){.line = 0, .offset = 0},
+            (struct LCDSize){.width = 5, .height = 3}, LCD_ALIGN_LEFT, "HELLO \n\nX", true,
+            "HELLO...............\n     ...............\nX    ...............\n....................")) {
+        return 1;
+    }
+
+    // Lines are sent in DDRAM address order, so a full screen starting from address 0 needs no
+    // addresses set at all (lines 0, 2, 1 and 3 are consecutive in DDRAM)
+    fill_screen();
+    uint32_t instructions = display.instructions;
+    lcd_write_box(size, (struct LCDPosition){.line = 0, .offset = 0}, size, LCD_ALIGN_LEFT,
+        "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyzab");
+    if (display.instructions != instructions) {
+        printf("A full screen box sent %" PRIu32 " instructions.\n", display.instructions - instructions);
+        return 1;
+    }
+
+    printf("Box check passed.\n");
+    return 0;
+}
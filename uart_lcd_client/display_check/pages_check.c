@@ -0,0 +1,132 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+
+#include <hd44780_emulator.h>
+#include <lcd_bus_emulated.h>
+#include <lcd_controller.h>
+#include <pages.h>
+
+// Writes to pages shown and hidden on an emulated display, checking that hidden pages are left
+// alone until shown, and that switching and rotating pages only sends the characters that differ.
+
+static struct HD44780Emulator display;
+
+static const char first_page[] =
+    "Visible page        \nline two            \n                    \n                    ";
+static const char second_page[] =
+    "Background          \npage                \nthird line          \n                    ";
+
+static bool check_screen(const char *step, struct LCDSize size, const char *expected,
+        struct LCDPosition cursor) {
+    char shown[LCD_STRING_MAX_CHARS];
+    hd44780_emulator_read(&display, size.width, size.height, shown);
+    if (strcmp(shown, expected) != 0) {
+        printf("%s: the display shows\n%s\ninstead of\n%s\n", step, shown, expected);
+        return false;
+    }
+    struct LCDPosition position = lcd_get_cursor_position(size);
+    if (position.line != cursor.line || position.offset != cursor.offset) {
+        printf("%s: the cursor is at %d, %d instead of %d, %d.\n",
+            step, position.line, position.offset, cursor.line, cursor.offset);
+        return false;
+    }
+    return true;
+}
+
+static bool check_data_writes(const char *step, uint32_t before, uint32_t expected) {
+    if (display.data_writes - before != expected) {
+        printf("%s: %" PRIu32 " characters were sent instead of %" PRIu32 ".\n",
+            step, display.data_writes - before, expected);
+        return false;
+    }
+    return true;
+}
+
+// The number of characters that differ between two screens of text
+static uint32_t count_differences(const char *a, const char *b) {
+    uint32_t count = 0;
+    for (; *a != 0 && *b != 0; a++, b++) {
+        count += *a != *b;
+    }
+    return count;
+}
+
+static bool check_switch(const char *step, struct LCDSize size, uint8_t index, const char *from,
+        const char *to, struct LCDPosition cursor) {
+    uint32_t data_writes = display.data_writes;
+    page_show(size, index);
+    if (page_get_visible() != index) {
+        printf("%s: page %d is visible instead of %d.\n", step, page_get_visible(), index);
+        return false;
+    }
+    return check_data_writes(step, data_writes, count_differences(from, to))
+        && check_screen(step, size, to, cursor);
+}
+
+int main(void) {
+    hd44780_emulator_init(&display);
+    lcd_init_emulated(&display, LCD_INTERFACE_8BIT);
+
+    struct LCDSize size = {.width = 20, .height = 4};
+    lcd_initialise_display(true, false);
+    lcd_display_set(true, false, false);
+
+    struct LCDPosition first_cursor = {.line = 1, .offset = 8};
+    struct LCDPosition second_cursor = {.line = 2, .offset = 10};
+
+    page_write(size, 0, "Visible page\nline two");
+    if (!check_screen("Visible page", size, first_page, first_cursor)) {
+        return 1;
+    }
+
+    // A hidden page is written without touching the display
+    uint32_t data_writes = display.data_writes;
+    page_write(size, 1, "Background\npage");
+    page_set_cursor_position(size, 1, (struct LCDPosition){.line = 2, .offset = 0});
+    page_write(size, 1, "third line");
+    if (!check_data_writes("Hidden page", data_writes, 0)
+            || !check_screen("Hidden page", size, first_page, first_cursor)) {
+        return 1;
+    }
+
+    // Switching pages only sends the characters that differ, and puts back each page's cursor
+    if (!check_switch("Show hidden page", size, 1, first_page, second_page, second_cursor)
+            || !check_switch("Show first page again", size, 0, second_page, first_page, first_cursor)) {
+        return 1;
+    }
+
+    // Rotation switches pages once each period has passed
+    page_set_rotation(1000, 0, 1);
+    if (page_rotate_if_due(size)) {
+        printf("Pages rotated before the period had passed.\n");
+        return 1;
+    }
+    sleep_us(1000 * 1000);
+    if (!page_rotate_if_due(size) || !check_screen("First rotation", size, second_page, second_cursor)) {
+        printf("Pages didn't rotate to the second page.\n");
+        return 1;
+    }
+    sleep_us(1000 * 1000);
+    if (!page_rotate_if_due(size) || !check_screen("Second rotation", size, first_page, first_cursor)) {
+        printf("Pages didn't rotate back to the first page.\n");
+        return 1;
+    }
+
+    // Something else can take over the display, then the visible page is put back
+    page_suspend(size);
+    if (page_get_next_rotation_us() != 0) {
+        printf("Suspending pages didn't stop rotation.\n");
+        return 1;
+    }
+    lcd_clear();
+    lcd_write(size, "Something else");
+    page_resume(size);
+    if (!check_screen("Resumed", size, first_page, first_cursor)) {
+        return 1;
+    }
+
+    printf("Pages check passed.\n");
+    return 0;
+}
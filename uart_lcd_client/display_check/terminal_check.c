@@ -0,0 +1,121 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <hd44780_emulator.h>
+#include <lcd_bus_emulated.h>
+#include <lcd_controller.h>
+
+// Writes to an emulated display in terminal mode, checking that scrolling only sends the
+// characters that change, and that lcd_read and scrolling back follow the history.
+
+static struct HD44780Emulator display;
+
+static bool check_screen(const char *step, struct LCDSize size, const char *expected) {
+    char shown[LCD_STRING_MAX_CHARS];
+    hd44780_emulator_read(&display, size.width, size.height, shown);
+    if (strcmp(shown, expected) != 0) {
+        printf("%s: the display shows\n%s\ninstead of\n%s\n", step, shown, expected);
+        return false;
+    }
+
+    uint32_t data_reads = display.data_reads;
+    char read[LCD_STRING_MAX_CHARS];
+    lcd_read(size, read);
+    if (strcmp(read, expected) != 0) {
+        printf("%s: lcd_read returned\n%s\ninstead of\n%s\n", step, read, expected);
+        return false;
+    }
+    if (display.data_reads != data_reads) {
+        printf("%s: lcd_read read from the display instead of the history.\n", step);
+        return false;
+    }
+    return true;
+}
+
+static bool check_data_writes(const char *step, uint32_t before, uint32_t expected) {
+    if (display.data_writes - before != expected) {
+        printf("%s: %" PRIu32 " characters were sent instead of %" PRIu32 ".\n",
+            step, display.data_writes - before, expected);
+        return false;
+    }
+    return true;
+}
+
+int main(void) {
+    hd44780_emulator_init(&display);
+    lcd_init_emulated(&display, LCD_INTERFACE_8BIT);
+
+    struct LCDSize size = {.width = 16, .height = 2};
+    lcd_initialise_display(true, false);
+    lcd_display_set(true, false, false);
+    lcd_set_terminal_mode(size, true);
+
+    // The next line is only started once there is something to put on it
+    lcd_write(size, "one\ntwo\nthree\n");
+    if (!check_screen("Trailing newline", size, "two             \nthree           ")) {
+        return 1;
+    }
+
+    // Scrolling up rewrites every line, but only the characters that differ should be sent
+    lcd_write(size, "status: 1\nstatus: 2\n");
+    uint32_t data_writes = display.data_writes;
+    lcd_write(size, "status: 3\n");
+    if (!check_data_writes("Scrolling similar lines", data_writes, 2)
+            || !check_screen("Scrolling similar lines", size, "status: 2       \nstatus: 3       ")) {
+        return 1;
+    }
+
+    // Long lines wrap onto a new line of the history
+    lcd_write(size, "abcdefghijklmnopqrs");
+    if (!check_screen("Wrapped line", size, "abcdefghijklmnop\nqrs             ")) {
+        return 1;
+    }
+
+    // Scrolling back shows, and reads, older lines
+    lcd_terminal_scroll(size, 3);
+    if (lcd_terminal_get_scrollback() != 3
+            || !check_screen("Scrolled back", size, "status: 1       \nstatus: 2       ")) {
+        return 1;
+    }
+
+    // New text goes into the history without moving the screen
+    data_writes = display.data_writes;
+    lcd_write(size, "\nwhile scrolled back");
+    if (!check_data_writes("Writing while scrolled back", data_writes, 0)
+            || !check_screen("Writing while scrolled back", size, "status: 1       \nstatus: 2       ")) {
+        return 1;
+    }
+
+    // Scrolling forward stops at the newest lines
+    lcd_terminal_scroll(size, -100);
+    if (lcd_terminal_get_scrollback() != 0
+            || !check_screen("Scrolled forward", size, "while scrolled b\nack             ")) {
+        return 1;
+    }
+
+    // Once the history is full, the oldest lines are discarded
+    lcd_clear();
+    char line[LCD_STRING_MAX_CHARS];
+    int line_count = LCD_TERMINAL_HISTORY_LINES + 10;
+    for (int i = 0; i < line_count; i++) {
+        snprintf(line, sizeof(line), "line %d\n", i);
+        lcd_write(size, line);
+    }
+    uint8_t max_scrollback = lcd_terminal_get_max_scrollback(size);
+    if (max_scrollback != LCD_TERMINAL_HISTORY_LINES - size.height) {
+        printf("Full history: can scroll back %d lines instead of %d.\n",
+            max_scrollback, LCD_TERMINAL_HISTORY_LINES - size.height);
+        return 1;
+    }
+    lcd_terminal_scroll(size, 1000);
+    char expected[LCD_STRING_MAX_CHARS];
+    snprintf(expected, sizeof(expected), "line %-11d\nline %-11d",
+        line_count - LCD_TERMINAL_HISTORY_LINES, line_count - LCD_TERMINAL_HISTORY_LINES + 1);
+    if (lcd_terminal_get_scrollback() != max_scrollback || !check_screen("Oldest lines", size, expected)) {
+        return 1;
+    }
+
+    printf("Terminal check passed.\n");
+    return 0;
+}
@@ -0,0 +1,184 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <flash_store.h>
+#include <flash_store_file.h>
+
+// Saves and loads records through flash_store backed by a file, including across power being lost
+// part way through programming a slot or erasing a sector.
+//   flash_store_check <path of a file to use as flash>
+
+#define SLOT_SIZE 512
+#define SLOTS_PER_SECTOR (FLASH_STORE_SECTOR_SIZE / SLOT_SIZE)
+#define SLOT_COUNT (FLASH_STORE_SECTOR_COUNT * SLOTS_PER_SECTOR)
+
+struct Record {
+    uint32_t number;
+    char text[200];
+};
+
+static const struct FlashStore store = {
+    .offset = FLASH_STORE_SECTOR_SIZE,
+    .slot_size = SLOT_SIZE
+};
+
+static const char *path;
+
+static struct Record make_record(uint32_t number) {
+    struct Record record = {.number = number};
+    snprintf(record.text, sizeof(record.text), "Record number %" PRIu32, number);
+    return record;
+}
+
+static bool check_newest(const char *step, uint32_t number) {
+    struct Record loaded;
+    if (!flash_store_load(&store, &loaded, sizeof(loaded))) {
+        printf("%s: no record could be loaded.\n", step);
+        return false;
+    }
+    struct Record expected = make_record(number);
+    if (memcmp(&loaded, &expected, sizeof(loaded)) != 0) {
+        printf("%s: loaded record %" PRIu32 " instead of %" PRIu32 ".\n", step, loaded.number, number);
+        return false;
+    }
+    return true;
+}
+
+static bool save(const char *step, uint32_t number) {
+    struct Record record = make_record(number);
+    if (!flash_store_save(&store, &record, sizeof(record))) {
+        printf("%s: saving record %" PRIu32 " failed.\n", step, number);
+        return false;
+    }
+    return check_newest(step, number);
+}
+
+// The slot holding a record, or -1 if it isn't in flash
+static int slot_holding(uint32_t number) {
+    for (int slot = 0; slot < SLOT_COUNT; slot++) {
+        uint32_t offset = store.offset + slot * SLOT_SIZE;
+        struct FlashStoreSlotHeader header;
+        struct Record record;
+        flash_store_device_read(offset, &header, sizeof(header));
+        flash_store_device_read(offset + sizeof(header), &record, sizeof(record));
+        if (header.magic == FLASH_STORE_MAGIC && record.number == number) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+static int sector_holding(uint32_t number) {
+    int slot = slot_holding(number);
+    return slot == -1 ? -1 : slot / SLOTS_PER_SECTOR;
+}
+
+// Overwrite part of the file directly, as power being lost can leave flash in any state
+static void overwrite(uint32_t offset, uint8_t value, size_t length) {
+    FILE *file = fopen(path, "r+b");
+    fseek(file, offset, SEEK_SET);
+    for (size_t i = 0; i < length; i++) {
+        fputc(value, file);
+    }
+    fclose(file);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        printf("Usage: %s <path of a file to use as flash>\n", argv[0]);
+        return 2;
+    }
+    path = argv[1];
+    remove(path);
+    flash_store_file_set_path(path);
+
+    struct Record record;
+    if (flash_store_load(&store, &record, sizeof(record))) {
+        printf("A record was loaded from empty flash.\n");
+        return 1;
+    }
+
+    // Fill the first sector, then the second, then go back to the first
+    uint32_t number = 0;
+    for (; number < SLOTS_PER_SECTOR; number++) {
+        if (!save("First sector", number)) {
+            return 1;
+        }
+    }
+    if (!save("Second sector", number) || sector_holding(number) != 1 || sector_holding(0) != 0) {
+        printf("Filling the first sector didn't move on to the second, leaving the first alone.\n");
+        return 1;
+    }
+    for (number++; number < 2 * SLOTS_PER_SECTOR; number++) {
+        if (!save("Second sector", number)) {
+            return 1;
+        }
+    }
+    if (!save("Back to first sector", number) || sector_holding(number) != 0
+            || sector_holding(number - 1) != 1 || sector_holding(0) != -1) {
+        printf("Filling the second sector didn't erase the first and move back to it.\n");
+        return 1;
+    }
+    number++;
+
+    // A record with a different length isn't the one being asked for
+    uint32_t other = 0;
+    if (flash_store_load(&store, &other, sizeof(other))) {
+        printf("A record was loaded with the wrong length.\n");
+        return 1;
+    }
+
+    // Power lost while programming the next slot, leaving its header written but not all of its data
+    int torn_slot = slot_holding(number - 1) + 1;
+    struct FlashStoreSlotHeader torn_header = {
+        .magic = FLASH_STORE_MAGIC,
+        .sequence = 0xFFFFFF,
+        .length = sizeof(struct Record),
+        .crc = 0
+    };
+    flash_store_device_program(store.offset + torn_slot * SLOT_SIZE, &torn_header, sizeof(torn_header));
+    if (!check_newest("Torn write", number - 1) || !save("After torn write", number)) {
+        return 1;
+    }
+    if (slot_holding(number) != torn_slot + 1) {
+        printf("Saving after a torn write didn't skip over its slot.\n");
+        return 1;
+    }
+    number++;
+
+    // Fill the rest of the first sector, so the next save erases the second
+    while (number % SLOTS_PER_SECTOR != SLOTS_PER_SECTOR - 1) {
+        if (!save("Filling first sector", number++)) {
+            return 1;
+        }
+    }
+    if (slot_holding(number - 1) != SLOTS_PER_SECTOR - 1) {
+        printf("The first sector wasn't filled in order.\n");
+        return 1;
+    }
+
+    // Power lost part way through erasing the second sector, before the new record was written
+    overwrite(store.offset + FLASH_STORE_SECTOR_SIZE, 0xFF, FLASH_STORE_SECTOR_SIZE / 2 + 100);
+    if (!check_newest("Torn erase", number - 1) || !save("After torn erase", number)) {
+        return 1;
+    }
+    if (sector_holding(number) != 1) {
+        printf("Saving after a torn erase didn't move on to the second sector.\n");
+        return 1;
+    }
+
+    // Everything erased
+    flash_store_erase(&store);
+    if (flash_store_load(&store, &record, sizeof(record))) {
+        printf("A record was loaded after erasing.\n");
+        return 1;
+    }
+    if (!save("After erasing", 1000)) {
+        return 1;
+    }
+
+    remove(path);
+    printf("Flash store check passed.\n");
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "uart_lcd_client.hpp"
+
+// Presents random frames to uart_lcd_stand_in through the client, and checks that
+// after each batch the emulated display holds exactly what the client planned for.
+//   plan_commands_check <path to uart_lcd_stand_in>
+
+namespace {
+
+constexpr int frame_count = 300;
+constexpr int frames_per_check = 25;
+
+struct StandIn {
+    pid_t pid;
+    int fd;
+};
+
+StandIn start_stand_in(const char *path) {
+    int pipe_fds[2];
+    if (pipe(pipe_fds) != 0) {
+        throw std::runtime_error("Could not create a pipe");
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // The stand-in prints the path of its terminal to stderr
+        dup2(pipe_fds[1], STDERR_FILENO);
+        // Start without any saved settings, and don't save any
+        setenv("UART_LCD_FLASH_FILE", "/nonexistent/uart_lcd_flash.bin", 1);
+        execl(path, path, static_cast<char *>(nullptr));
+        _exit(1);
+    }
+    close(pipe_fds[1]);
+
+    std::string terminal;
+    char c;
+    while (read(pipe_fds[0], &c, 1) == 1 && c != '\n') {
+        terminal += c;
+    }
+    close(pipe_fds[0]);
+    if (terminal.empty()) {
+        throw std::runtime_error("The stand-in didn't start");
+    }
+    return StandIn{pid, uart_lcd::open_serial(terminal)};
+}
+
+void stop_stand_in(const StandIn &stand_in) {
+    close(stand_in.fd);
+    kill(stand_in.pid, SIGTERM);
+    waitpid(stand_in.pid, nullptr, 0);
+}
+
+// Run a command directly, bypassing the client, and return everything it printed
+std::string run_command(int fd, const std::string &command) {
+    std::string line = command + "\n";
+    if (write(fd, line.data(), line.size()) != static_cast<ssize_t>(line.size())) {
+        throw std::runtime_error("Could not write to the stand-in");
+    }
+
+    // The command is echoed along with its line ending, then a new line is started
+    std::string echo = command + "\n\n";
+    std::string prompt = "\n> ";
+    std::string output;
+    while (output.size() < echo.size() + prompt.size()
+            || output.compare(output.size() - prompt.size(), prompt.size(), prompt) != 0) {
+        pollfd poll_fd = {fd, POLLIN, 0};
+        char buffer[256];
+        ssize_t count;
+        if (poll(&poll_fd, 1, 2000) != 1 || (count = read(fd, buffer, sizeof(buffer))) <= 0) {
+            throw std::runtime_error("No response from the stand-in to " + command);
+        }
+        // The stand-in sends each line ending as "\r\n", like the Pico SDK
+        output.append(buffer, std::remove(buffer, buffer + count, '\r') - buffer);
+    }
+    return output.substr(echo.size(), output.size() - echo.size() - prompt.size());
+}
+
+// The byte display memory should hold for a cell of a frame
+std::uint8_t expected_byte(char c) {
+    return c >= '\x01' && c <= '\x08' ? c - 1 : static_cast<std::uint8_t>(c);
+}
+
+std::string setpos_command(int index, int width) {
+    return "#setpos " + std::to_string(index / width + 1) + " " + std::to_string(index % width);
+}
+
+std::string expected_read_custom(const uart_lcd::Glyph &glyph) {
+    std::string expected;
+    for (std::uint8_t row : glyph) {
+        for (int bit = 4; bit >= 0; bit--) {
+            expected += row >> bit & 1 ? '1' : '0';
+        }
+        expected += ' ';
+    }
+    return expected + "\n";
+}
+
+bool check_display(int fd, const uart_lcd::Frame &frame, const uart_lcd::DisplayMirror &mirror) {
+    // Read display memory back one line at a time, so custom characters can be told apart
+    for (int line = 0; line < frame.height(); line++) {
+        run_command(fd, setpos_command(line * frame.width(), frame.width()));
+        for (int offset = 0; offset < frame.width(); offset++) {
+            unsigned shown;
+            std::string response = run_command(fd, "#raw_rx 1");
+            if (std::sscanf(response.c_str(), "%*s (0x%x)", &shown) != 1) {
+                std::cerr << "Unexpected response to #raw_rx: " << response;
+                return false;
+            }
+            std::uint8_t expected = expected_byte(frame.at(line, offset));
+            if (shown != expected) {
+                std::cerr << "Line " << line + 1 << " offset " << offset << " holds 0x" << std::hex << shown
+                    << " instead of 0x" << static_cast<unsigned>(expected) << std::dec << "\n";
+                return false;
+            }
+        }
+    }
+    // Put the cursor back where the client believes it is
+    if (mirror.cursor_known()) {
+        run_command(fd, setpos_command(mirror.cursor(), frame.width()));
+    }
+
+    for (int i = 0; i < uart_lcd::custom_char_count; i++) {
+        const std::optional<uart_lcd::Glyph> &glyph = frame.custom_char(i);
+        if (glyph && run_command(fd, "#read_custom " + std::to_string(i)) != expected_read_custom(*glyph)) {
+            std::cerr << "Custom character " << i << " doesn't match the frame\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool check_size(const char *stand_in_path, int width, int height, std::mt19937 &random) {
+    StandIn stand_in = start_stand_in(stand_in_path);
+    uart_lcd::Client client(stand_in.fd, width, height);
+    client.connect();
+    client.initialise();
+
+    // Weighted towards the characters the client has to treat specially
+    std::vector<char> alphabet = {'#', '@', '\b', '\n', '\r', '\x7f', '\xa5', '\xff', '\0'};
+    for (char c = ' '; c <= '~'; c++) {
+        alphabet.push_back(c);
+    }
+    for (int i = 0; i < uart_lcd::custom_char_count; i++) {
+        alphabet.push_back(uart_lcd::Frame::custom(i));
+        alphabet.push_back(uart_lcd::Frame::custom(i));
+    }
+    auto random_char = [&]() {
+        return alphabet[std::uniform_int_distribution<std::size_t>(0, alphabet.size() - 1)(random)];
+    };
+    auto chance = [&](double probability) {
+        return std::bernoulli_distribution(probability)(random);
+    };
+    std::uniform_int_distribution<int> random_line(0, height - 1);
+    std::uniform_int_distribution<int> random_offset(0, width - 1);
+
+    uart_lcd::Frame frame(width, height);
+    bool passed = true;
+    for (int i = 1; i <= frame_count && passed; i++) {
+        if (chance(0.02)) {
+            frame.fill(random_char());
+        }
+        if (chance(0.1)) {
+            int line = random_line(random);
+            int offset = random_offset(random);
+            std::string text;
+            for (int length = random_offset(random); length >= 0; length--) {
+                text += random_char();
+            }
+            frame.write(line, offset, text);
+        }
+        for (int changes = std::uniform_int_distribution<int>(0, 5)(random); changes > 0; changes--) {
+            frame.set(random_line(random), random_offset(random), random_char());
+        }
+        if (chance(0.05)) {
+            uart_lcd::Glyph glyph;
+            for (std::uint8_t &row : glyph) {
+                row = std::uniform_int_distribution<int>(0, 0b11111)(random);
+            }
+            frame.define_custom_char(std::uniform_int_distribution<int>(0, 7)(random), glyph);
+        }
+
+        client.present(frame);
+        if (i % frames_per_check == 0) {
+            client.flush();
+            passed = check_display(stand_in.fd, frame, client.mirror());
+        }
+    }
+
+    stop_stand_in(stand_in);
+    std::cout << width << "x" << height << (passed ? " passed" : " failed") << "\n";
+    return passed;
+}
+
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 2) {
+        std::cerr << "Usage: " << argv[0] << " <path to uart_lcd_stand_in>\n";
+        return 2;
+    }
+
+    std::mt19937 random(12345);
+    bool passed = true;
+    try {
+        passed = check_size(argv[1], 16, 2, random) && passed;
+        passed = check_size(argv[1], 20, 4, random) && passed;
+        passed = check_size(argv[1], 40, 2, random) && passed;
+    } catch (const std::exception &error) {
+        std::cerr << error.what() << "\n";
+        return 1;
+    }
+    return passed ? 0 : 1;
+}
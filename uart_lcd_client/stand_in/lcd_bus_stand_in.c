@@ -0,0 +1,31 @@
+#include <hd44780_emulator.h>
+#include <lcd_bus.h>
+#include <lcd_bus_emulated.h>
+#include <lcd_controller.h>
+
+static struct HD44780Emulator display;
+
+// Takes the place of the GPIO bus, so the firmware drives an emulated display instead
+void lcd_init_gpio(enum LCDInterface interface) {
+    hd44780_emulator_init(&display);
+    lcd_init_emulated(&display, interface);
+}
+
+// The emulated display has no backlight to dim, so fades finish immediately
+static uint8_t backlight_level = 0;
+
+void _lcd_pwm_backlight_init(void) {
+    backlight_level = 0;
+}
+
+void _lcd_pwm_backlight_fade(uint8_t level, uint32_t fade_ms) {
+    backlight_level = level;
+}
+
+void _lcd_pwm_backlight_breathe(uint8_t level, uint32_t period_ms) {
+    backlight_level = level;
+}
+
+uint8_t _lcd_pwm_backlight_get_level(void) {
+    return backlight_level;
+}
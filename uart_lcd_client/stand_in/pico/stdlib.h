@@ -0,0 +1,30 @@
+#ifndef PICO_STDLIB_H
+#define PICO_STDLIB_H
+
+// The small part of the Pico SDK used by uart_lcd, implemented for a Linux host
+// so the firmware can be run unmodified as a stand-in for a real device.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PICO_ERROR_TIMEOUT -1
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
+
+typedef unsigned int uint;
+
+/*
+* Open a pseudo-terminal and connect standard input and output to it,
+* printing the path of the terminal for clients to open.
+*/
+bool stdio_init_all(void);
+int getchar_timeout_us(uint32_t timeout_us);
+// Called whenever input is found waiting, standing in for the UART interrupt
+void stdio_set_chars_available_callback(void (*callback)(void *), void *param);
+
+uint64_t time_us_64(void);
+void sleep_us(uint64_t us);
+
+// The stand-in has no pins to drive
+void gpio_put(uint gpio, bool value);
+
+#endif
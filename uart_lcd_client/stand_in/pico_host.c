@@ -0,0 +1,130 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "pico/stdlib.h"
+
+#include <flash_store_file.h>
+
+static int terminal_fd = -1;
+
+static void (*chars_available_callback)(void *) = NULL;
+static void *chars_available_param = NULL;
+
+// Whether the last character written was '\r', as the Pico SDK doesn't add another before a '\n' that follows one
+static bool wrote_carriage_return = false;
+
+/*
+* Write output to the terminal with each '\n' sent as "\r\n",
+* like the Pico SDK's stdio does by default (PICO_STDIO_DEFAULT_CRLF).
+*/
+static ssize_t _write_crlf(void *cookie, const char *data, size_t size) {
+    (void)cookie;
+    char translated[2 * BUFSIZ];
+    size_t used = 0;
+    size_t taken = 0;
+    while (taken < size && used + 2 <= sizeof(translated)) {
+        char c = data[taken++];
+        if (c == '\n' && !wrote_carriage_return) {
+            translated[used++] = '\r';
+        }
+        translated[used++] = c;
+        wrote_carriage_return = c == '\r';
+    }
+
+    size_t written = 0;
+    while (written < used) {
+        ssize_t count = write(terminal_fd, translated + written, used - written);
+        if (count < 0 && errno != EINTR) {
+            return -1;
+        }
+        written += count > 0 ? count : 0;
+    }
+    return taken;
+}
+
+bool stdio_init_all(void) {
+    const char *flash_path = getenv("UART_LCD_FLASH_FILE");
+    if (flash_path != NULL) {
+        flash_store_file_set_path(flash_path);
+    }
+
+    terminal_fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (terminal_fd < 0 || grantpt(terminal_fd) != 0 || unlockpt(terminal_fd) != 0) {
+        perror("Could not open a pseudo-terminal");
+        exit(1);
+    }
+    const char *path = ptsname(terminal_fd);
+
+    // Keep the client side open ourselves, otherwise every read fails while no client is connected.
+    // It also holds the terminal settings, so set it up like a raw serial port.
+    int client_fd = open(path, O_RDWR | O_NOCTTY);
+    struct termios settings;
+    if (client_fd < 0 || tcgetattr(client_fd, &settings) != 0) {
+        perror("Could not open the client side of the pseudo-terminal");
+        exit(1);
+    }
+    cfmakeraw(&settings);
+    tcsetattr(client_fd, TCSANOW, &settings);
+
+    fprintf(stderr, "%s\n", path);
+    fflush(stderr);
+
+    fflush(stdout);
+    dup2(terminal_fd, STDIN_FILENO);
+    dup2(terminal_fd, STDOUT_FILENO);
+    stdout = fopencookie(NULL, "w", (cookie_io_functions_t){.write = _write_crlf});
+    return true;
+}
+
+void stdio_set_chars_available_callback(void (*callback)(void *), void *param) {
+    chars_available_callback = callback;
+    chars_available_param = param;
+}
+
+int getchar_timeout_us(uint32_t timeout_us) {
+    // Anything printed before waiting for input has to reach the client first
+    fflush(stdout);
+
+    struct pollfd poll_fd = {.fd = STDIN_FILENO, .events = POLLIN};
+    int ready = poll(&poll_fd, 1, (int)((timeout_us + 999) / 1000));
+    if (ready == 0) {
+        return PICO_ERROR_TIMEOUT;
+    }
+    if (chars_available_callback != NULL) {
+        chars_available_callback(chars_available_param);
+    }
+
+    unsigned char c;
+    ssize_t count;
+    do {
+        count = read(STDIN_FILENO, &c, 1);
+    } while (count < 0 && errno == EINTR);
+    if (count != 1) {
+        // Nothing more can arrive
+        exit(0);
+    }
+    return c;
+}
+
+uint64_t time_us_64(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+void sleep_us(uint64_t us) {
+    struct timespec duration = {.tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000};
+    nanosleep(&duration, NULL);
+}
+
+void gpio_put(uint gpio, bool value) {
+    (void)gpio;
+    (void)value;
+}
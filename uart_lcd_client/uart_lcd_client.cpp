@@ -0,0 +1,558 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <system_error>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "uart_lcd_client.hpp"
+
+namespace uart_lcd {
+
+namespace {
+
+constexpr std::string_view prompt = "\n> ";
+
+// Firmware reads at most 127 characters per line, keep well clear of that
+constexpr std::size_t max_text_length = 120;
+
+// Enough to erase anything already typed into the firmware's 128 byte input buffer
+constexpr std::size_t erase_length = 128;
+
+bool is_custom(char c) {
+    return c >= '\x01' && c <= '\x08';
+}
+
+// The byte that ends up in display memory for a cell
+std::uint8_t display_byte(char c) {
+    return is_custom(c) ? static_cast<std::uint8_t>(c - 1) : static_cast<std::uint8_t>(c);
+}
+
+/*
+* Whether a character can be sent as part of a line of text.
+* The firmware treats these as line endings or backspaces
+* (custom character 7 is sent as 0x08, which is ASCII backspace).
+*/
+bool is_text_safe(char c) {
+    return c != '\r' && c != '\n' && c != '\b' && c != '\x7f';
+}
+
+// Whether a character can start a line of text without it being taken for a command
+bool can_start_text(char c) {
+    return is_text_safe(c) && c != '#';
+}
+
+std::string binary(unsigned value, int digits) {
+    std::string result(digits, '0');
+    for (int i = digits - 1; i >= 0; i--, value >>= 1) {
+        if (value & 1) {
+            result[i] = '1';
+        }
+    }
+    return result;
+}
+
+std::string setpos_command(int index, int width) {
+    return "#setpos " + std::to_string(index / width + 1) + " " + std::to_string(index % width);
+}
+
+// Commands for a single character that can't be sent as text
+std::string single_char_command(char c) {
+    if (c == '\b') {
+        return "#write_custom 7";
+    }
+    return "#raw_tx 1 " + binary(display_byte(c), 8);
+}
+
+/*
+* Remove every '\r' from what was received, returning how many characters are left.
+* The Pico SDK sends each '\n' as "\r\n" by default, but the firmware can be built without that,
+* so echoes and prompts are only ever matched against '\n'.
+*/
+std::size_t strip_carriage_returns(char *buffer, std::size_t count) {
+    return std::remove(buffer, buffer + count, '\r') - buffer;
+}
+
+void check_size(int width, int height) {
+    if (width < 1 || width > max_width || height < 1 || height > max_height
+            || width * height > max_chars) {
+        throw std::invalid_argument("Unsupported display size");
+    }
+}
+
+void check_custom_index(int index) {
+    if (index < 0 || index >= custom_char_count) {
+        throw std::out_of_range("Custom character index must be between 0 and 7");
+    }
+}
+
+}
+
+CommandError::CommandError(const std::string &command, const std::string &response)
+    : std::runtime_error("Command \"" + command + "\" failed: " + response),
+      command_(command), response_(response) {}
+
+Frame::Frame(int width, int height)
+    : width_(width), height_(height), cells_(width * height, ' ') {
+    check_size(width, height);
+}
+
+char Frame::at(int line, int offset) const {
+    if (line < 0 || line >= height_ || offset < 0 || offset >= width_) {
+        throw std::out_of_range("Position is outside the frame");
+    }
+    return cells_[line * width_ + offset];
+}
+
+void Frame::set(int line, int offset, char c) {
+    if (line < 0 || line >= height_ || offset < 0 || offset >= width_) {
+        throw std::out_of_range("Position is outside the frame");
+    }
+    // Display memory 0x00 is custom character 0, the same as 0x01
+    cells_[line * width_ + offset] = c == '\0' ? custom(0) : c;
+}
+
+void Frame::write(int line, int offset, std::string_view text) {
+    for (char c : text) {
+        if (offset >= width_) {
+            break;
+        }
+        set(line, offset++, c);
+    }
+}
+
+void Frame::fill(char c) {
+    std::fill(cells_.begin(), cells_.end(), c == '\0' ? custom(0) : c);
+}
+
+const std::optional<Glyph> &Frame::custom_char(int index) const {
+    check_custom_index(index);
+    return custom_chars_[index];
+}
+
+void Frame::define_custom_char(int index, const Glyph &glyph) {
+    check_custom_index(index);
+    custom_chars_[index] = glyph;
+}
+
+DisplayMirror::DisplayMirror(int width, int height)
+    : width_(width), height_(height), cells_(width * height, ' '), known_(width * height, false) {
+    check_size(width, height);
+}
+
+void DisplayMirror::invalidate() {
+    std::fill(known_.begin(), known_.end(), false);
+    custom_chars_.fill(std::nullopt);
+    cursor_known_ = false;
+}
+
+void DisplayMirror::set_cursor(int index) {
+    cursor_ = index;
+    cursor_known_ = true;
+}
+
+void DisplayMirror::write(char c) {
+    cells_[cursor_] = c;
+    known_[cursor_] = true;
+    // Writing past the end of a line moves onto the next, and the last line wraps back to the first
+    cursor_ = (cursor_ + 1) % static_cast<int>(cells_.size());
+}
+
+void DisplayMirror::clear() {
+    std::fill(cells_.begin(), cells_.end(), ' ');
+    std::fill(known_.begin(), known_.end(), true);
+    set_cursor(0);
+}
+
+void DisplayMirror::define_custom_char(int index, const Glyph &glyph) {
+    custom_chars_[index] = glyph;
+}
+
+std::vector<std::string> plan_commands(DisplayMirror &mirror, const Frame &frame) {
+    if (frame.width() != mirror.width() || frame.height() != mirror.height()) {
+        throw std::invalid_argument("Frame is a different size to the display");
+    }
+
+    std::vector<std::string> commands;
+
+    // Redefining a custom character changes it everywhere it is shown, so do these first
+    for (int i = 0; i < custom_char_count; i++) {
+        const std::optional<Glyph> &glyph = frame.custom_char(i);
+        if (glyph && mirror.custom_char(i) != glyph) {
+            std::string command = "#def_custom " + std::to_string(i);
+            for (std::uint8_t row : *glyph) {
+                command += " " + binary(row & 0b11111, 5);
+            }
+            commands.push_back(command);
+            mirror.define_custom_char(i, *glyph);
+        }
+    }
+
+    const std::string &cells = frame.cells();
+    int count = static_cast<int>(cells.size());
+    int width = frame.width();
+    auto changed = [&](int index) {
+        return !mirror.known(index) || mirror.cell(index) != cells[index];
+    };
+
+    // Text waiting to be sent as a single line, which always ends at the mirror's cursor
+    std::string text;
+    auto end_text = [&]() {
+        if (!text.empty()) {
+            commands.push_back(text);
+            text.clear();
+        }
+    };
+    auto write_cell = [&](int index) {
+        char c = cells[index];
+        if (text.size() >= max_text_length) {
+            end_text();
+        }
+        if (text.empty() ? can_start_text(c) : is_text_safe(c)) {
+            text += c;
+            mirror.write(c);
+            return;
+        }
+
+        end_text();
+        commands.push_back(single_char_command(c));
+        mirror.write(c);
+        if (c != '\b' && index % width == width - 1) {
+            // Raw writes don't move onto the next line like text does
+            mirror.invalidate_cursor();
+        }
+    };
+
+    for (int index = 0; index < count; index++) {
+        if (!changed(index)) {
+            continue;
+        }
+
+        int cursor = mirror.cursor();
+        bool can_bridge = mirror.cursor_known() && cursor <= index;
+        if (can_bridge) {
+            // Rewriting the unchanged characters in between is worth it if it's no longer than moving the cursor
+            std::size_t jump_cost = setpos_command(index, width).size() + 1 + (text.empty() ? 0 : 1);
+            if (static_cast<std::size_t>(index - cursor) > jump_cost) {
+                can_bridge = false;
+            }
+            for (int i = cursor; can_bridge && i < index; i++) {
+                bool starts_text = i == cursor && text.empty();
+                can_bridge = starts_text ? can_start_text(cells[i]) : is_text_safe(cells[i]);
+            }
+        }
+
+        if (can_bridge) {
+            for (int i = cursor; i < index; i++) {
+                write_cell(i);
+            }
+        } else {
+            end_text();
+            int start = index;
+            if (!can_start_text(cells[index]) && is_text_safe(cells[index])
+                    && index % width != 0 && !changed(index - 1) && can_start_text(cells[index - 1])) {
+                // Start one character early rather than sending a character
+                // that would be taken for a command on its own
+                start = index - 1;
+            }
+            commands.push_back(setpos_command(start, width));
+            mirror.set_cursor(start);
+            if (start != index) {
+                write_cell(start);
+            }
+        }
+        write_cell(index);
+    }
+    end_text();
+
+    return commands;
+}
+
+Client::Client(int fd, int width, int height, ClientOptions options)
+    : fd_(fd), options_(options), mirror_(width, height) {}
+
+void Client::connect() {
+    queued_.clear();
+    in_flight_.clear();
+    in_flight_bytes_ = 0;
+    error_.reset();
+    mirror_.invalidate();
+
+    // Anything already sent by the device is from before we were connected
+    tcflush(fd_, TCIFLUSH);
+    received_.clear();
+
+    // Backspacing over anything partially typed is harmless, unlike ending the line
+    write_all(std::string(erase_length, '\x7f'));
+
+    std::string set_size = "#set_size " + std::to_string(mirror_.height())
+        + " " + std::to_string(mirror_.width());
+    write_all(set_size + "\n");
+    std::string response = wait_for_response(set_size);
+    if (!response.empty()) {
+        throw CommandError(set_size, response);
+    }
+
+    write_all("#getpos\n");
+    response = wait_for_response("#getpos");
+    int line;
+    int offset;
+    if (std::sscanf(response.c_str(), "line: %d, offset: %d", &line, &offset) != 2) {
+        throw CommandError("#getpos", response);
+    }
+    mirror_.set_cursor((line - 1) * mirror_.width() + offset);
+    received_.clear();
+}
+
+void Client::initialise(bool two_lines, bool large_font) {
+    queued_.emplace_back(std::string("#init ") + (two_lines ? "2" : "1") + (large_font ? " 11" : " 8"), true);
+    // The display is left turned off after being initialised
+    queued_.emplace_back("#set 1 0 0", true);
+    mirror_.clear();
+    pump(false);
+}
+
+void Client::clear() {
+    queued_.emplace_back("#clear", true);
+    mirror_.clear();
+    pump(false);
+}
+
+void Client::backlight(bool on) {
+    queued_.emplace_back(on ? "#backlight 1" : "#backlight 0", true);
+    pump(false);
+}
+
+void Client::set_backlight(int percent, int fade_ms) {
+    if (percent < 0 || percent > 100 || fade_ms < 0) {
+        throw std::out_of_range("Backlight brightness must be between 0 and 100");
+    }
+    std::string command = "#brightness " + std::to_string(percent);
+    if (fade_ms != 0) {
+        command += " " + std::to_string(fade_ms);
+    }
+    queued_.emplace_back(command, true);
+    pump(false);
+}
+
+void Client::present(const Frame &frame) {
+    std::vector<std::string> commands = plan_commands(mirror_, frame);
+    for (std::string &command : commands) {
+        queued_.emplace_back(std::move(command), true);
+    }
+    pump(false);
+}
+
+void Client::send(const std::string &command) {
+    // There's no telling what the command did to the display
+    queued_.emplace_back(command, false);
+    mirror_.invalidate();
+    pump(false);
+}
+
+void Client::flush() {
+    pump(true);
+}
+
+void Client::pump(bool wait) {
+    while (true) {
+        while (!queued_.empty()) {
+            const auto &[command, check_response] = queued_.front();
+            std::size_t length = command.size() + 1;
+            if (!in_flight_.empty()
+                    && (in_flight_bytes_ + length > options_.max_in_flight_bytes
+                        || in_flight_.size() >= options_.max_in_flight_commands)) {
+                break;
+            }
+            write_all(command + "\n");
+            // The device echoes the line, including its ending, then starts a new line
+            in_flight_.push_back(InFlight{command, "", length + 1, check_response});
+            in_flight_bytes_ += length;
+            queued_.pop_front();
+        }
+
+        if (!wait) {
+            // Only take what has already arrived
+            if (!read_responses(0)) {
+                break;
+            }
+        } else if (queued_.empty() && in_flight_.empty()) {
+            break;
+        } else if (!read_responses(options_.timeout_ms)) {
+            throw std::system_error(std::make_error_code(std::errc::timed_out),
+                "No response from the display");
+        }
+    }
+
+    if (error_) {
+        CommandError error = *error_;
+        error_.reset();
+        throw error;
+    }
+}
+
+bool Client::read_responses(int timeout_ms) {
+    pollfd poll_fd = {fd_, POLLIN, 0};
+    int ready = poll(&poll_fd, 1, timeout_ms);
+    if (ready < 0) {
+        if (errno == EINTR) {
+            return true;
+        }
+        throw std::system_error(errno, std::generic_category(), "Could not wait for the display");
+    }
+    if (ready == 0) {
+        return false;
+    }
+
+    char buffer[256];
+    ssize_t count = read(fd_, buffer, sizeof(buffer));
+    if (count < 0) {
+        if (errno == EINTR || errno == EAGAIN) {
+            return true;
+        }
+        throw std::system_error(errno, std::generic_category(), "Could not read from the display");
+    }
+    if (count == 0) {
+        throw std::system_error(std::make_error_code(std::errc::io_error), "Display disconnected");
+    }
+    count = strip_carriage_returns(buffer, count);
+
+    for (ssize_t i = 0; i < count && !in_flight_.empty(); i++) {
+        InFlight &current = in_flight_.front();
+        if (current.echo_remaining > 0) {
+            current.echo_remaining--;
+            continue;
+        }
+
+        current.response += buffer[i];
+        if (current.response.size() >= prompt.size()
+                && current.response.compare(current.response.size() - prompt.size(), prompt.size(), prompt) == 0) {
+            // The prompt means the device is done with the command
+            current.response.resize(current.response.size() - prompt.size());
+            // None of the commands sent for a frame print anything unless they fail
+            if (current.check_response && !current.response.empty() && !error_) {
+                fail(current.command, current.response);
+            }
+            in_flight_bytes_ -= current.command.size() + 1;
+            in_flight_.pop_front();
+        }
+    }
+    return true;
+}
+
+void Client::write_all(const std::string &data) {
+    std::size_t written = 0;
+    while (written < data.size()) {
+        ssize_t count = write(fd_, data.data() + written, data.size() - written);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                pollfd poll_fd = {fd_, POLLOUT, 0};
+                poll(&poll_fd, 1, options_.timeout_ms);
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "Could not write to the display");
+        }
+        written += count;
+    }
+}
+
+std::string Client::wait_for_response(const std::string &command) {
+    std::string echo = command + "\n\n";
+    std::size_t response_start = std::string::npos;
+    while (true) {
+        if (response_start == std::string::npos) {
+            std::size_t echo_start = received_.find(echo);
+            if (echo_start != std::string::npos) {
+                response_start = echo_start + echo.size();
+            }
+        }
+        if (response_start != std::string::npos) {
+            std::size_t prompt_start = received_.find(prompt, response_start);
+            if (prompt_start != std::string::npos) {
+                std::string response = received_.substr(response_start, prompt_start - response_start);
+                received_.erase(0, prompt_start + prompt.size());
+                // Messages end with a new line, which isn't part of them
+                while (!response.empty() && response.back() == '\n') {
+                    response.pop_back();
+                }
+                return response;
+            }
+        }
+
+        pollfd poll_fd = {fd_, POLLIN, 0};
+        int ready = poll(&poll_fd, 1, options_.timeout_ms);
+        if (ready == 0) {
+            throw std::system_error(std::make_error_code(std::errc::timed_out),
+                "No response from the display");
+        }
+        char buffer[256];
+        ssize_t count = ready < 0 ? -1 : read(fd_, buffer, sizeof(buffer));
+        if (count < 0 && errno != EINTR && errno != EAGAIN) {
+            throw std::system_error(errno, std::generic_category(), "Could not read from the display");
+        }
+        if (count == 0) {
+            throw std::system_error(std::make_error_code(std::errc::io_error), "Display disconnected");
+        }
+        if (count > 0) {
+            received_.append(buffer, strip_carriage_returns(buffer, count));
+        }
+    }
+}
+
+void Client::fail(const std::string &command, const std::string &response) {
+    std::string message = response;
+    while (!message.empty() && (message.back() == '\n' || message.back() == '\r')) {
+        message.pop_back();
+    }
+    error_ = CommandError(command, message);
+    // Nothing sent from here on can be trusted to have done what was expected
+    mirror_.invalidate();
+}
+
+int open_serial(const std::string &path, int baud_rate) {
+    int fd = open(path.c_str(), O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Could not open " + path);
+    }
+
+    termios settings;
+    if (tcgetattr(fd, &settings) != 0) {
+        int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "Could not configure " + path);
+    }
+    cfmakeraw(&settings);
+    settings.c_cflag |= CLOCAL | CREAD;
+
+    speed_t speed;
+    switch (baud_rate) {
+        case 9600: speed = B9600; break;
+        case 19200: speed = B19200; break;
+        case 38400: speed = B38400; break;
+        case 57600: speed = B57600; break;
+        case 115200: speed = B115200; break;
+        case 230400: speed = B230400; break;
+        case 460800: speed = B460800; break;
+        case 921600: speed = B921600; break;
+        default:
+            close(fd);
+            throw std::invalid_argument("Unsupported baud rate");
+    }
+    cfsetispeed(&settings, speed);
+    cfsetospeed(&settings, speed);
+
+    if (tcsetattr(fd, TCSANOW, &settings) != 0) {
+        int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "Could not configure " + path);
+    }
+    return fd;
+}
+
+}
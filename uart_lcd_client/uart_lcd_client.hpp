@@ -0,0 +1,209 @@
+#ifndef UART_LCD_CLIENT_HPP
+#define UART_LCD_CLIENT_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace uart_lcd {
+
+// Must match the limits of the uart_lcd firmware
+constexpr int max_width = 40;
+constexpr int max_height = 4;
+constexpr int max_chars = 80;
+constexpr int custom_char_count = 8;
+
+// Pixel rows of a custom character from top to bottom, using the lowest 5 bits of each
+using Glyph = std::array<std::uint8_t, 8>;
+
+/*
+* A command the display rejected. Whatever is on the display is no longer known.
+*/
+class CommandError : public std::runtime_error {
+public:
+    CommandError(const std::string &command, const std::string &response);
+
+    const std::string &command() const { return command_; }
+    const std::string &response() const { return response_; }
+
+private:
+    std::string command_;
+    std::string response_;
+};
+
+/*
+* The full contents of the display.
+* Cells hold characters the same way the firmware's text input does:
+* 0x01-0x08 are custom characters 0-7, and anything else is a character from the display's ROM.
+*/
+class Frame {
+public:
+    Frame(int width, int height);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    char at(int line, int offset) const;
+    void set(int line, int offset, char c);
+    // Write text from a position, stopping at the end of the line
+    void write(int line, int offset, std::string_view text);
+    void fill(char c);
+
+    const std::optional<Glyph> &custom_char(int index) const;
+    void define_custom_char(int index, const Glyph &glyph);
+
+    // The cell value that shows a custom character
+    static char custom(int index) { return static_cast<char>(index + 1); }
+
+    // Cells from the top line to the bottom line
+    const std::string &cells() const { return cells_; }
+
+private:
+    int width_;
+    int height_;
+    std::string cells_;
+    std::array<std::optional<Glyph>, custom_char_count> custom_chars_;
+};
+
+/*
+* What is believed to be on the remote display after every command sent so far.
+* Cells and custom characters that have not been written since the mirror was invalidated are unknown.
+*/
+class DisplayMirror {
+public:
+    DisplayMirror(int width, int height);
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    bool known(int index) const { return known_[index]; }
+    char cell(int index) const { return cells_[index]; }
+    const std::optional<Glyph> &custom_char(int index) const { return custom_chars_[index]; }
+    // Index of the cell the next character will be written to, counting along each line in turn
+    int cursor() const { return cursor_; }
+    bool cursor_known() const { return cursor_known_; }
+
+    void invalidate();
+    void set_cursor(int index);
+    void invalidate_cursor() { cursor_known_ = false; }
+    // Record a character written at the cursor and move the cursor the same way the firmware does
+    void write(char c);
+    void clear();
+    void define_custom_char(int index, const Glyph &glyph);
+
+private:
+    int width_;
+    int height_;
+    std::string cells_;
+    std::vector<bool> known_;
+    std::array<std::optional<Glyph>, custom_char_count> custom_chars_;
+    int cursor_ = 0;
+    bool cursor_known_ = false;
+};
+
+/*
+* Get the commands that take the display from the contents of the mirror to the frame,
+* using as few bytes as possible. The mirror is updated as if they had all been run.
+*/
+std::vector<std::string> plan_commands(DisplayMirror &mirror, const Frame &frame);
+
+struct ClientOptions {
+    // Stop sending once this many bytes of commands are waiting to be handled.
+    // The Pico has no software receive buffer, only a 32 byte hardware FIFO, and the firmware
+    // doesn't read from it while handling a command (initialising or recovering the display,
+    // saving to flash, or printing a response), so anything past that is dropped.
+    // A single command longer than this is still sent on its own, once the device is waiting for input.
+    std::size_t max_in_flight_bytes = 24;
+    // Stop sending once this many commands are waiting to be handled
+    std::size_t max_in_flight_commands = 8;
+    // How long to wait for the device to respond before giving up
+    int timeout_ms = 2000;
+};
+
+/*
+* Keeps a remote uart_lcd display in step with frames given to it, over an already open serial port.
+* Commands are pipelined, so several can be travelling to and being handled by the device at once.
+* Errors reading from or writing to the port are thrown as std::system_error.
+*/
+class Client {
+public:
+    // The file descriptor is not closed by the client
+    Client(int fd, int width, int height, ClientOptions options = {});
+
+    /*
+    * Discard anything partially typed on the device, set its screen size,
+    * and find out where its cursor is. Must be called before anything else.
+    */
+    void connect();
+
+    // Initialise the display, which clears it
+    void initialise(bool two_lines = true, bool large_font = false);
+    void clear();
+    void backlight(bool on);
+    // Set the backlight brightness from 0 to 100 percent, fading to it over fade_ms if given
+    void set_backlight(int percent, int fade_ms = 0);
+
+    /*
+    * Queue the commands needed to show a frame. Commands are sent as space is available,
+    * and anything left is sent by the next call or by flush().
+    * Throws CommandError if the device rejected any commands sent so far.
+    */
+    void present(const Frame &frame);
+
+    /*
+    * Send a command to the device as-is, after any commands already queued.
+    * Anything it prints is discarded, and the display is assumed to need redrawing in full.
+    */
+    void send(const std::string &command);
+
+    // Wait for every queued command to be handled
+    void flush();
+
+    // Forget what is on the display, so the next frame is drawn in full
+    void invalidate() { mirror_.invalidate(); }
+
+    const DisplayMirror &mirror() const { return mirror_; }
+
+private:
+    struct InFlight {
+        std::string command;
+        // Output seen so far after the echo of the command
+        std::string response;
+        std::size_t echo_remaining;
+        // Whether any output means the command failed
+        bool check_response;
+    };
+
+    void pump(bool wait);
+    bool read_responses(int timeout_ms);
+    void write_all(const std::string &data);
+    std::string wait_for_response(const std::string &command);
+    void fail(const std::string &command, const std::string &response);
+
+    int fd_;
+    ClientOptions options_;
+    DisplayMirror mirror_;
+    // Commands waiting to be sent, and whether to check their output
+    std::deque<std::pair<std::string, bool>> queued_;
+    std::deque<InFlight> in_flight_;
+    std::size_t in_flight_bytes_ = 0;
+    std::string received_;
+    std::optional<CommandError> error_;
+};
+
+/*
+* Open a serial port (or pseudo-terminal) and set it up for talking to uart_lcd:
+* raw 8-bit data with no echo or line editing.
+*/
+int open_serial(const std::string &path, int baud_rate = 115200);
+
+}
+
+#endif